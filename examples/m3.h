@@ -84,7 +84,8 @@ public:
 
   /**
    * Retrieves the dataframe of numbers from the KVStore, and sums each number.
-   * The elements on the KVStore are stored across all 3 nodes.
+   * The elements on the KVStore are stored across all 3 nodes, and are scanned
+   * a chunk at a time.
    */
   void counter()
   {
@@ -92,10 +93,13 @@ public:
     Deserializer dser(val.data(), val.length());
     auto df = DataFrame::deserialize(dser);
     size_t sum = 0;
-    for (size_t i = 0; i < DF_TEST_SIZE; ++i)
-    {
-      sum += df->get_double(0, i, kv);
-    }
+    df->cols_.at(0)->as_double()->for_each_chunk(
+        kv, [&](Span<const double> vals, BitmapView validity, size_t start) {
+          for (double v : vals)
+          {
+            sum += v;
+          }
+        });
     DataFrame::fromScalar(verify, kv, sum);
   }
 
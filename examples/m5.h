@@ -70,6 +70,8 @@ public:
 
   SetUpdater(Set &set) : set_(set) {}
 
+  std::vector<size_t> columns() override { return {0}; }
+
   /** Assume a row with at least one column of type I. Assumes that there
    * are no missing. Reads the value and sets the corresponding position.
    * The return value is irrelevant here. */
@@ -127,6 +129,9 @@ public:
 
   ProjectsTagger(Set &uSet, Set &pSet, std::shared_ptr<DataFrame> proj) : uSet(uSet), pSet(pSet), newProjects(proj) {}
 
+  /** Only the project and the author are read. */
+  std::vector<size_t> columns() override { return {0, 1}; }
+
   /** The data frame must have at least two integer columns. The newProject
    * set keeps track of projects that were newly tagged (they will have to
    * be communicated to other nodes). */
@@ -161,6 +166,9 @@ public:
 
   UsersTagger(Set &pSet, Set &uSet, std::shared_ptr<DataFrame> users) : pSet(pSet), uSet(uSet), newUsers() {}
 
+  /** Only the project and the author are read. */
+  std::vector<size_t> columns() override { return {0, 1}; }
+
   bool visit(Row &row) override
   {
     int pid = row.get_int(0);
@@ -284,7 +292,9 @@ public:
     auto newUsers = DataFrame::deserialize(dser);
     Set delta(users);
     SetUpdater upd(delta);
-    newUsers->map(upd); // all of the new users are copied to delta.
+    // Only this node reads newUsers, so it is scanned whole, locally: the
+    // distributed map is a barrier that every node would have to join.
+    newUsers->local_map(upd, kv); // all of the new users are copied to delta.
     ProjectsTagger ptagger(delta, *pSet, projects);
     commits->local_map(ptagger, kv); // marking all projects touched by delta
     merge(ptagger.newProjects, "projects-", stage);
@@ -323,7 +333,7 @@ public:
         std::cout << "    received delta of " << delta->nrows() << " elements from node " << i << std::endl;
         ;
         SetUpdater upd(set);
-        delta->map(upd);
+        delta->local_map(upd, kv); // only node 0 reads the deltas, see step
       }
       std::cout << "    storing " << set.size() << " merged elements" << std::endl;
       ;
@@ -357,7 +367,7 @@ public:
       std::cout << "    receiving " << merged->nrows() << " merged elements" << std::endl;
       ;
       SetUpdater upd(set);
-      merged->map(upd);
+      merged->local_map(upd, kv); // scanned whole by each node, see step
     }
   }
 }; // Linus
@@ -58,7 +58,7 @@ public:
       val = Value(nullptr, 0);
     }
     auto reply_msg = std::make_shared<Reply>(
-        MsgKind::Reply, idx_, get_msg->sender_, 0, val.data(), val.length());
+        MsgKind::Reply, idx_, get_msg->sender_, get_msg->id_, val);
     net_->send_msg(reply_msg);
   }
 
@@ -7,13 +7,37 @@
 
 #pragma once
 #include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include "../util/bitmap.h"
 #include "../util/serial.h"
+#include "../util/string_arena.h"
+#include "codecs.h"
+#include "column_traits.h"
+#include "zone_map.h"
 
-class IntColumnChunk;
-class BoolColumnChunk;
-class DoubleColumnChunk;
-class StringColumnChunk;
+const uint32_t CHUNK_MAGIC = 0x6b6e6863; // "chnk"
+
+/**
+ * Fixed header at the start of every serialized chunk. It is followed by
+ * validity_words_ 64-bit validity words and then the payload, so the
+ * payload of a chunk always starts on an 8-byte boundary of the buffer.
+ * Fixed-width payloads are laid out as plain arrays and can be read in
+ * place (see ColumnChunkView).
+ */
+struct ChunkHeader
+{
+  uint32_t magic_;          // always CHUNK_MAGIC
+  char type_;               // 'I', 'B', 'D' or 'S'
+  uint8_t encoding_;        // payload encoding, one of the ENCODING_ constants
+  uint16_t reserved_;       // padding, always 0
+  uint64_t count_;          // number of elements in the chunk
+  uint64_t validity_words_; // 0 when every element is present
+};
+
+static_assert(sizeof(ChunkHeader) == 24, "chunk header must stay 8-byte aligned");
 
 /**************************************************************************
  * ColumnChunk ::
@@ -21,12 +45,19 @@ class StringColumnChunk;
  * 
  * The Column that owns this chunk is respnsible for monitoring the size
  * of this chunk. 
+ *
+ * Every chunk carries a validity bitmap with one bit per element; a cleared
+ * bit marks a missing value. The bitmap is serialized along with the values.
  * */
 class ColumnChunk
 {
 public:
+  Bitmap validity_; // bit i is set iff element i is present
+
   ColumnChunk() = default;
 
+  ColumnChunk(Bitmap validity) : validity_(std::move(validity)) {}
+
   virtual ~ColumnChunk() = default;
 
   /** Type converters: Return same column under its actual type, or
@@ -46,130 +77,281 @@ public:
   /** Returns the number of elements in the column. */
   virtual size_t size() = 0;
 
+  /** Returns true if the element at idx is missing. */
+  bool is_missing(size_t idx) { return !validity_.test(idx); }
+
+  /** Marks the element at idx as missing. */
+  void mark_missing(size_t idx) { validity_.set(idx, false); }
+
+  /** Returns the number of missing elements in this chunk. */
+  size_t null_count() { return validity_.size() - validity_.count(); }
+
+  /** Returns the zone map of this chunk. Subclasses add the range and the
+   * distinct values of their present values. */
+  virtual ChunkStats stats()
+  {
+    ChunkStats res;
+    res.null_count_ = null_count();
+    return res;
+  }
+
   /** Serializes this chunk into bytes */
   virtual void serialize(Serializer &ser) {}
+
+  /**
+   * Writes the chunk header and validity words. The validity words are
+   * left out entirely when no element is missing.
+   */
+  void serialize_header_(Serializer &ser, char type, uint8_t encoding = ENCODING_PLAIN)
+  {
+    bool all_valid = validity_.all();
+    ChunkHeader h = {CHUNK_MAGIC, type, encoding, 0, validity_.size(), all_valid ? 0 : validity_.words_.size()};
+    ser.write_bytes(&h, sizeof(h));
+    if (!all_valid)
+    {
+      ser.write_bytes(validity_.words_.data(), validity_.words_.size() * sizeof(uint64_t));
+    }
+  }
+
+  /** Reads a header written by serialize_header_, and the validity bitmap */
+  static ChunkHeader deserialize_header_(Deserializer &dser, Bitmap &validity)
+  {
+    ChunkHeader h;
+    dser.read_bytes(&h, sizeof(h));
+    if (h.magic_ != CHUNK_MAGIC)
+    {
+      throw std::runtime_error("bad chunk!");
+    }
+    if (h.validity_words_ == 0)
+    {
+      validity = Bitmap(h.count_, true);
+    }
+    else
+    {
+      std::vector<uint64_t> words(h.validity_words_);
+      dser.read_bytes(words.data(), words.size() * sizeof(uint64_t));
+      validity = Bitmap(words, h.count_);
+    }
+    return h;
+  }
 };
 
 /**
- * A column chunk of integers. Refer to parent class for relevant documentation.
+ * TypedColumnChunk::
+ * The parts of a chunk that only depend on its element type T, described by
+ * ColumnTraits<T>: the values, appending and reading them, and the zone
+ * map. Subclasses add the serialized format. Refer to parent class for
+ * relevant documentation.
  */
-class IntColumnChunk : public ColumnChunk
+template <typename T>
+class TypedColumnChunk : public ColumnChunk
 {
 public:
-  std::vector<int> vals_;
+  using Traits = ColumnTraits<T>;
+  using Storage = typename Traits::Storage;
 
-  IntColumnChunk() {}
+  Storage vals_;
 
-  IntColumnChunk(std::vector<int> vals) : vals_(vals) {}
+  TypedColumnChunk() = default;
 
-  ~IntColumnChunk() { vals_.clear(); }
+  TypedColumnChunk(Storage vals) : ColumnChunk(Bitmap(vals.size(), true)), vals_(std::move(vals)) {}
 
-  std::shared_ptr<IntColumnChunk> as_int() { return std::shared_ptr<IntColumnChunk>(this); }
+  TypedColumnChunk(Storage vals, Bitmap validity) : ColumnChunk(std::move(validity)), vals_(std::move(vals)) {}
 
-  int get(size_t idx) { return vals_.at(idx); }
+  auto get(size_t idx) { return Traits::get(vals_, idx); }
 
-  void push_back(int val) { vals_.push_back(val); }
+  void push_back(T val)
+  {
+    Traits::push_back(vals_, val);
+    validity_.push_back(true);
+  }
 
   size_t size() { return vals_.size(); }
 
-  void serialize(Serializer &ser) { ser.write_int_vector(vals_); }
-
-  static std::shared_ptr<IntColumnChunk> deserialize(Deserializer &dser)
+  ChunkStats stats()
   {
-    std::vector<int> arr = dser.read_int_vector();
-    return std::make_shared<IntColumnChunk>(arr);
+    ChunkStats res = ColumnChunk::stats();
+    for (size_t i = 0; i < vals_.size(); i++)
+    {
+      if (!is_missing(i))
+      {
+        Traits::add_stats(res, vals_, i);
+      }
+    }
+    return res;
   }
 };
 
 /**
- * A column chunk of bools. Refer to parent class for relevant documentation.
+ * A column chunk of integers. Refer to parent class for relevant documentation.
  */
-class BoolColumnChunk : public ColumnChunk
+class IntColumnChunk : public TypedColumnChunk<int>
 {
 public:
-  std::vector<bool> vals_;
-
-  BoolColumnChunk() = default;
-
-  BoolColumnChunk(std::vector<bool> vals) : vals_(vals) {}
+  using TypedColumnChunk::TypedColumnChunk;
 
-  ~BoolColumnChunk() { vals_.clear(); }
+  std::shared_ptr<IntColumnChunk> as_int() { return std::shared_ptr<IntColumnChunk>(this); }
 
-  std::shared_ptr<BoolColumnChunk> as_bool() { return std::shared_ptr<BoolColumnChunk>(this); }
+  /** The payload is written with whichever of the IntCodecs encodings
+   * makes it smallest. */
+  void serialize(Serializer &ser)
+  {
+    uint8_t encoding = IntCodecs::choose(vals_);
+    serialize_header_(ser, 'I', encoding);
+    IntCodecs::encode(encoding, vals_, ser);
+  }
 
-  bool get(size_t idx) { return vals_.at(idx); }
+  static std::shared_ptr<IntColumnChunk> deserialize(Deserializer &dser)
+  {
+    Bitmap validity;
+    ChunkHeader h = deserialize_header_(dser, validity);
+    std::vector<int> arr(h.count_);
+    size_t len = IntCodecs::decode(h.encoding_, dser.data_ + dser.index_, h.count_, arr.data());
+    dser.set_index(dser.index_ + len);
+    return std::make_shared<IntColumnChunk>(arr, validity);
+  }
+};
 
-  void push_back(bool val) { vals_.push_back(val); }
+/**
+ * A column chunk of bools. The values are packed 64 to a word, both in
+ * memory and in the serialized payload. Refer to parent class for relevant
+ * documentation.
+ */
+class BoolColumnChunk : public TypedColumnChunk<bool>
+{
+public:
+  using TypedColumnChunk::TypedColumnChunk;
 
-  size_t size() { return vals_.size(); }
+  std::shared_ptr<BoolColumnChunk> as_bool() { return std::shared_ptr<BoolColumnChunk>(this); }
 
-  void serialize(Serializer &ser) { ser.write_bool_vector(vals_); }
+  void serialize(Serializer &ser)
+  {
+    serialize_header_(ser, 'B');
+    ser.write_bytes(vals_.words_.data(), vals_.words_.size() * sizeof(uint64_t));
+  }
 
   static std::shared_ptr<BoolColumnChunk> deserialize(Deserializer &dser)
   {
-    std::vector<bool> arr = dser.read_bool_vector();
-    return std::make_shared<BoolColumnChunk>(arr);
+    Bitmap validity;
+    ChunkHeader h = deserialize_header_(dser, validity);
+    std::vector<uint64_t> words((h.count_ + 63) / 64);
+    dser.read_bytes(words.data(), words.size() * sizeof(uint64_t));
+    return std::make_shared<BoolColumnChunk>(Bitmap(words, h.count_), validity);
   }
 };
 
 /**
  * A column chunk of doubles. Refer to parent class for relevant documentation.
  */
-class DoubleColumnChunk : public ColumnChunk
+class DoubleColumnChunk : public TypedColumnChunk<double>
 {
 public:
-  std::vector<double> vals_;
-
-  DoubleColumnChunk() {}
-
-  DoubleColumnChunk(std::vector<double> vals) : vals_(vals) {}
-
-  ~DoubleColumnChunk() { vals_.clear(); }
+  using TypedColumnChunk::TypedColumnChunk;
 
   std::shared_ptr<DoubleColumnChunk> as_double() { return std::shared_ptr<DoubleColumnChunk>(this); }
 
-  double get(size_t idx) { return vals_.at(idx); }
-
-  void push_back(double val) { vals_.push_back(val); }
-
-  size_t size() { return vals_.size(); }
-
-  void serialize(Serializer &ser) { ser.write_double_vector(vals_); }
+  /** The payload is XOR-compressed (see DoubleCodecs) if that makes it
+   * smaller, and plain otherwise. */
+  void serialize(Serializer &ser)
+  {
+    std::vector<uint64_t> words = DoubleCodecs::encode_xor(vals_);
+    uint8_t encoding = 8 + 8 * words.size() < vals_.size() * sizeof(double) ? ENCODING_XOR : ENCODING_PLAIN;
+    serialize_header_(ser, 'D', encoding);
+    DoubleCodecs::encode(encoding, vals_, words, ser);
+  }
 
   static std::shared_ptr<DoubleColumnChunk> deserialize(Deserializer &dser)
   {
-    std::vector<double> arr = dser.read_double_vector();
-    return std::make_shared<DoubleColumnChunk>(arr);
+    Bitmap validity;
+    ChunkHeader h = deserialize_header_(dser, validity);
+    std::vector<double> arr(h.count_);
+    size_t len = DoubleCodecs::decode(h.encoding_, dser.data_ + dser.index_, h.count_, arr.data());
+    dser.set_index(dser.index_ + len);
+    return std::make_shared<DoubleColumnChunk>(arr, validity);
   }
 };
 
 /**
- * A column chunk of Strings. Refer to parent class for relevant documentation.
+ * A column chunk of Strings, held in a StringArena. Refer to parent class
+ * for relevant documentation.
+ *
+ * Plain chunks are serialized as their arena: the offsets of the strings
+ * followed by their bytes. Chunks with few distinct values are serialized
+ * with a dictionary instead: an arena of the distinct strings, in order of
+ * first appearance, followed by one 32-bit code per value indexing into it.
+ * The offsets and the codes start on 8-byte boundaries of the chunk, so
+ * they can be read in place, and equality tests against a dictionary chunk
+ * can compare codes instead of strings.
  */
-class StringColumnChunk : public ColumnChunk
+class StringColumnChunk : public TypedColumnChunk<std::string>
 {
 public:
-  std::vector<std::string> vals_;
-
-  StringColumnChunk() {}
-
-  StringColumnChunk(std::vector<std::string> vals) : vals_(vals) {}
-
-  ~StringColumnChunk() { vals_.clear(); }
+  using TypedColumnChunk::TypedColumnChunk;
 
   std::shared_ptr<StringColumnChunk> as_string() { return std::shared_ptr<StringColumnChunk>(this); }
 
-  std::string get(size_t idx) { return vals_.at(idx); }
-
-  void push_back(std::string val) { vals_.push_back(val); }
-
-  size_t size() { return vals_.size(); }
+  /**
+   * Builds the dictionary of this chunk's values and their codes. Returns
+   * false, leaving dict and codes unfinished, as soon as more than half of
+   * the values turn out to be distinct, since a dictionary would not pay
+   * for itself.
+   */
+  bool build_dictionary(StringArena &dict, std::vector<uint32_t> &codes)
+  {
+    std::unordered_map<std::string_view, uint32_t> index;
+    codes.reserve(vals_.size());
+    for (size_t i = 0; i < vals_.size(); i++)
+    {
+      std::string_view str = vals_.get(i);
+      auto search = index.find(str);
+      if (search == index.end())
+      {
+        if (2 * (dict.size() + 1) > vals_.size())
+        {
+          return false;
+        }
+        search = index.emplace(str, dict.size()).first;
+        dict.push_back(str);
+      }
+      codes.push_back(search->second);
+    }
+    return true;
+  }
 
-  void serialize(Serializer &ser) { ser.write_string_vector(vals_); }
+  void serialize(Serializer &ser)
+  {
+    StringArena dict;
+    std::vector<uint32_t> codes;
+    if (!build_dictionary(dict, codes))
+    {
+      serialize_header_(ser, 'S');
+      vals_.serialize(ser);
+      return;
+    }
+    serialize_header_(ser, 'S', ENCODING_DICT);
+    dict.serialize(ser);
+    uint64_t zero = 0;
+    ser.write_bytes(&zero, (8 - ser.length() % 8) % 8);
+    ser.write_bytes(codes.data(), codes.size() * sizeof(uint32_t));
+  }
 
   static std::shared_ptr<StringColumnChunk> deserialize(Deserializer &dser)
   {
-    std::vector<std::string> arr = dser.read_string_vector();
-    return std::make_shared<StringColumnChunk>(arr);
+    Bitmap validity;
+    ChunkHeader h = deserialize_header_(dser, validity);
+    if (h.encoding_ != ENCODING_DICT)
+    {
+      return std::make_shared<StringColumnChunk>(StringArena::deserialize(dser), validity);
+    }
+    StringArena dict = StringArena::deserialize(dser);
+    dser.set_index(dser.index_ + (8 - dser.index_ % 8) % 8);
+    std::vector<uint32_t> codes(h.count_);
+    dser.read_bytes(codes.data(), codes.size() * sizeof(uint32_t));
+    StringArena arr;
+    for (uint32_t code : codes)
+    {
+      arr.push_back(dict.get(code));
+    }
+    return std::make_shared<StringColumnChunk>(arr, validity);
   }
-};
\ No newline at end of file
+};
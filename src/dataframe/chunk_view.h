@@ -0,0 +1,200 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../kvstore/kv.h"
+#include "chunk.h"
+
+/**************************************************************************
+ * ColumnChunkView ::
+ * A read-only view of a serialized chunk, as stored in the KVStore.
+ *
+ * The view keeps a (shared) copy of the Value it was built from and reads
+ * values straight out of its bytes: plain int and double payloads are used
+ * in place as arrays, packed bool payloads and the validity bitmap are read
+ * word by word, and strings are returned as views into the string bytes.
+ * Only compressed int and double payloads are decoded, once, when the view
+ * is built.
+ *
+ * The ColumnChunk classes remain the representation used while a column
+ * is being written; views are what columns hand out when reading.
+ */
+class ColumnChunkView
+{
+public:
+  Value value_;                         // keeps the viewed bytes alive
+  const ChunkHeader *header_;           // header at the start of value_
+  const uint64_t *validity_;            // validity words, nullptr if all valid
+  const char *payload_;                 // first byte after the validity words
+  const int *ints_ = nullptr;           // values of an int chunk
+  std::vector<int> decoded_ints_;       // values of an encoded int chunk
+  const double *doubles_ = nullptr;     // values of a double chunk
+  std::vector<double> decoded_doubles_; // values of an encoded double chunk
+  const uint64_t *offsets_ = nullptr;   // string offsets, of the values or the dictionary
+  const char *bytes_ = nullptr;         // string bytes the offsets point into
+  size_t num_strings_ = 0;              // number of strings the offsets describe
+  const uint32_t *codes_ = nullptr;     // codes of a dictionary chunk
+  std::unordered_map<std::string_view, uint32_t> dict_index_; // code of each dictionary string, see find_code
+  std::once_flag dict_index_built_;
+
+  ColumnChunkView(Value value) : value_(value)
+  {
+    if (value_.length() < sizeof(ChunkHeader))
+    {
+      throw std::runtime_error("bad chunk!");
+    }
+    header_ = reinterpret_cast<const ChunkHeader *>(value_.data());
+    if (header_->magic_ != CHUNK_MAGIC)
+    {
+      throw std::runtime_error("bad chunk!");
+    }
+    const char *cursor = value_.data() + sizeof(ChunkHeader);
+    validity_ = header_->validity_words_ == 0 ? nullptr : reinterpret_cast<const uint64_t *>(cursor);
+    payload_ = cursor + header_->validity_words_ * sizeof(uint64_t);
+    if (header_->type_ == 'S')
+    {
+      locate_strings_();
+    }
+    else if (header_->type_ == 'I')
+    {
+      decode_ints_();
+    }
+    else if (header_->type_ == 'D')
+    {
+      decode_doubles_();
+    }
+  }
+
+  ~ColumnChunkView() = default;
+
+  /** Number of elements in the chunk. */
+  size_t size() { return header_->count_; }
+
+  /** Type of the chunk: 'I', 'B', 'D' or 'S' */
+  char get_type() { return header_->type_; }
+
+  /** The validity bitmap of the chunk, read in place. */
+  BitmapView validity() { return BitmapView(validity_, size()); }
+
+  /** Returns true if the element at idx is missing. */
+  bool is_missing(size_t idx) { return !validity().test(idx); }
+
+  /** Returns the number of missing elements in the chunk. */
+  size_t null_count() { return size() - validity().count(); }
+
+  /** The payload of fixed-width chunks as arrays. Asking for the wrong
+   * type is undefined. */
+  const int *ints()
+  {
+    assert(get_type() == 'I');
+    return ints_;
+  }
+
+  const double *doubles()
+  {
+    assert(get_type() == 'D');
+    return doubles_;
+  }
+
+  /** Bool payloads are packed 64 to a word, so they are viewed as bits. */
+  BitmapView bools()
+  {
+    assert(get_type() == 'B');
+    return BitmapView(reinterpret_cast<const uint64_t *>(payload_), size());
+  }
+
+  /** Typed getters. Element idx must be less than size(). */
+  int get_int(size_t idx) { return ints()[idx]; }
+
+  double get_double(size_t idx) { return doubles()[idx]; }
+
+  bool get_bool(size_t idx) { return bools().test(idx); }
+
+  /** Returns a view of the string at idx, valid as long as this view. */
+  std::string_view get_string(size_t idx) { return string_at_(codes_ ? codes_[idx] : idx); }
+
+  /** True if this is a dictionary-encoded string chunk. */
+  bool is_dict() { return codes_ != nullptr; }
+
+  /** Number of distinct strings in a dictionary chunk. */
+  size_t dict_size() { return num_strings_; }
+
+  /** Returns the code of str in this chunk's dictionary, or -1 if the
+   * dictionary does not hold it. Only valid for dictionary chunks. The
+   * first call hashes the dictionary, once per view, even if the view is
+   * shared by several threads. */
+  long find_code(std::string_view str)
+  {
+    assert(is_dict());
+    std::call_once(dict_index_built_, [this] {
+      dict_index_.reserve(num_strings_);
+      for (size_t i = 0; i < num_strings_; i++)
+      {
+        dict_index_.emplace(string_at_(i), i);
+      }
+    });
+    auto search = dict_index_.find(str);
+    return search == dict_index_.end() ? -1 : (long)search->second;
+  }
+
+  /** Number of bytes this view keeps alive, used to charge it in caches. */
+  size_t byte_size()
+  {
+    return sizeof(ColumnChunkView) + value_.length() + decoded_ints_.size() * sizeof(int) +
+           decoded_doubles_.size() * sizeof(double);
+  }
+
+private:
+  /** Plain int payloads are used in place; encoded ones are decoded once,
+   * into a buffer owned by the view */
+  void decode_ints_()
+  {
+    if (header_->encoding_ == ENCODING_PLAIN)
+    {
+      ints_ = reinterpret_cast<const int *>(payload_);
+      return;
+    }
+    decoded_ints_.resize(size());
+    IntCodecs::decode(header_->encoding_, payload_, size(), decoded_ints_.data());
+    ints_ = decoded_ints_.data();
+  }
+
+  void decode_doubles_()
+  {
+    if (header_->encoding_ == ENCODING_PLAIN)
+    {
+      doubles_ = reinterpret_cast<const double *>(payload_);
+      return;
+    }
+    decoded_doubles_.resize(size());
+    DoubleCodecs::decode(header_->encoding_, payload_, size(), decoded_doubles_.data());
+    doubles_ = decoded_doubles_.data();
+  }
+
+  /** Finds the offsets and bytes of a serialized StringArena, and the codes
+   * that follow it in a dictionary chunk */
+  void locate_strings_()
+  {
+    memcpy(&num_strings_, payload_, sizeof(size_t));
+    offsets_ = reinterpret_cast<const uint64_t *>(payload_ + sizeof(size_t));
+    bytes_ = reinterpret_cast<const char *>(offsets_ + num_strings_ + 1);
+    if (header_->encoding_ == ENCODING_DICT)
+    {
+      size_t offset = bytes_ + offsets_[num_strings_] - value_.data();
+      codes_ = reinterpret_cast<const uint32_t *>(value_.data() + offset + (8 - offset % 8) % 8);
+    }
+  }
+
+  std::string_view string_at_(size_t i) { return std::string_view(bytes_ + offsets_[i], offsets_[i + 1] - offsets_[i]); }
+};
@@ -0,0 +1,505 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../util/serial.h"
+#include "kernels.h"
+
+/** Payload encodings, stored in ChunkHeader::encoding_ */
+const uint8_t ENCODING_PLAIN = 0; // values one after the other
+const uint8_t ENCODING_DICT = 1;  // distinct strings, then a 32-bit code per value
+const uint8_t ENCODING_FOR = 2;   // ints as bit-packed offsets from their minimum
+const uint8_t ENCODING_DELTA = 3; // ints as bit-packed differences from the previous
+const uint8_t ENCODING_RLE = 4;   // ints as runs of equal values
+const uint8_t ENCODING_XOR = 5;   // doubles XORed with the previous value
+
+/**
+ * IntCodecs::
+ * Lightweight compression for int chunk payloads.
+ *
+ * Frame of reference (FOR) stores the minimum of the chunk and every value
+ * as its offset from it, in just enough bits for the largest offset. Delta
+ * does the same with the differences between neighbouring values, which
+ * suits sorted and clustered ids. Run-length (RLE) stores each run of equal
+ * values once, with its length. All three keep their arrays 8-byte aligned
+ * within the payload.
+ *
+ *   FOR:   int64 base, uint64 width, packed offsets
+ *   DELTA: int64 first, int64 base, uint64 width, packed differences
+ *   RLE:   uint64 runs, int32 values[runs], uint32 lengths[runs]
+ *
+ * Packed arrays are followed by one extra zero word, so that the decoder
+ * may load 32 bits at the byte holding any packed value. On x86 with AVX2,
+ * values of up to 25 bits are unpacked 8 at a time with a gather.
+ */
+class IntCodecs
+{
+public:
+  /** Number of bits needed to store v. */
+  static uint64_t bit_width(uint64_t v)
+  {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+  }
+
+  /** Number of words in a packed array of n values of the given width. */
+  static size_t packed_words(size_t n, uint64_t width)
+  {
+    return (n * width + 63) / 64 + 1;
+  }
+
+  /** Packs the low width bits of each of vals into words. */
+  static std::vector<uint64_t> pack(const std::vector<uint64_t> &vals, uint64_t width)
+  {
+    std::vector<uint64_t> words(packed_words(vals.size(), width), 0);
+    for (size_t i = 0; width > 0 && i < vals.size(); i++)
+    {
+      size_t pos = i * width;
+      words[pos / 64] |= vals[i] << (pos % 64);
+      if (pos % 64 + width > 64)
+      {
+        words[pos / 64 + 1] |= vals[i] >> (64 - pos % 64);
+      }
+    }
+    return words;
+  }
+
+  /** Sets out[i] to base plus the i-th packed value, modulo 2^32. */
+  static void unpack_scalar(const uint64_t *words, size_t start, size_t n, uint64_t width, uint32_t base, uint32_t *out)
+  {
+    uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    for (size_t i = start; i < n; i++)
+    {
+      size_t pos = i * width;
+      uint64_t v = words[pos / 64] >> (pos % 64);
+      if (pos % 64 + width > 64)
+      {
+        v |= words[pos / 64 + 1] << (64 - pos % 64);
+      }
+      out[i] = base + (uint32_t)(v & mask);
+    }
+  }
+
+#ifdef EAU2_X86
+
+  __attribute__((target("avx2"))) static void unpack_avx2(const uint64_t *words, size_t n, uint64_t width, uint32_t base, uint32_t *out)
+  {
+    const int *bytes = reinterpret_cast<const int *>(words);
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i step = _mm256_set1_epi32(8 * width);
+    __m256i pos = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(width));
+    __m256i mask = _mm256_set1_epi32((1U << width) - 1);
+    __m256i seven = _mm256_set1_epi32(7);
+    __m256i vbase = _mm256_set1_epi32(base);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_i32gather_epi32(bytes, _mm256_srli_epi32(pos, 3), 1);
+      v = _mm256_and_si256(_mm256_srlv_epi32(v, _mm256_and_si256(pos, seven)), mask);
+      _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(v, vbase));
+      pos = _mm256_add_epi32(pos, step);
+    }
+    unpack_scalar(words, i, n, width, base, out);
+  }
+
+#endif // EAU2_X86
+
+  /** Sets out[i] to base plus the i-th of n packed values, modulo 2^32. */
+  static void unpack(const uint64_t *words, size_t n, uint64_t width, uint32_t base, uint32_t *out)
+  {
+#ifdef EAU2_X86
+    // byte offsets of the values must fit in the gather's 32-bit lanes
+    if (width > 0 && width <= 25 && n * width < (1ULL << 31) && Kernels::has_avx2())
+    {
+      unpack_avx2(words, n, width, base, out);
+      return;
+    }
+#endif
+    unpack_scalar(words, 0, n, width, base, out);
+  }
+
+  /** Serialized payload sizes of n values under each encoding. A size of
+   * SIZE_MAX means the encoding cannot represent the values. */
+  static size_t plain_size(const std::vector<int> &vals) { return vals.size() * sizeof(int); }
+
+  static size_t for_size(const std::vector<int> &vals)
+  {
+    int64_t lo, hi;
+    bounds_(vals, lo, hi);
+    return 16 + 8 * packed_words(vals.size(), bit_width(hi - lo));
+  }
+
+  static size_t delta_size(const std::vector<int> &vals)
+  {
+    int64_t lo, hi;
+    delta_bounds_(vals, lo, hi);
+    uint64_t width = bit_width(hi - lo);
+    return width > 32 ? SIZE_MAX : 24 + 8 * packed_words(vals.size(), width);
+  }
+
+  static size_t rle_size(const std::vector<int> &vals)
+  {
+    size_t runs = 0;
+    for (size_t i = 0; i < vals.size(); i++)
+    {
+      runs += i == 0 || vals[i] != vals[i - 1];
+    }
+    return 8 + 8 * runs;
+  }
+
+  /** Returns the encoding giving the smallest payload for vals. */
+  static uint8_t choose(const std::vector<int> &vals)
+  {
+    uint8_t best = ENCODING_PLAIN;
+    size_t best_size = plain_size(vals);
+    size_t sizes[] = {for_size(vals), delta_size(vals), rle_size(vals)};
+    uint8_t encodings[] = {ENCODING_FOR, ENCODING_DELTA, ENCODING_RLE};
+    for (size_t i = 0; i < 3; i++)
+    {
+      if (sizes[i] < best_size)
+      {
+        best = encodings[i];
+        best_size = sizes[i];
+      }
+    }
+    return best;
+  }
+
+  /** Writes vals with the given encoding. */
+  static void encode(uint8_t encoding, const std::vector<int> &vals, Serializer &ser)
+  {
+    switch (encoding)
+    {
+    case ENCODING_PLAIN:
+      ser.write_bytes(vals.data(), vals.size() * sizeof(int));
+      break;
+    case ENCODING_FOR:
+    {
+      int64_t lo, hi;
+      bounds_(vals, lo, hi);
+      std::vector<uint64_t> offsets(vals.size());
+      for (size_t i = 0; i < vals.size(); i++)
+      {
+        offsets[i] = vals[i] - lo;
+      }
+      write_packed_(ser, lo, offsets, bit_width(hi - lo));
+      break;
+    }
+    case ENCODING_DELTA:
+    {
+      int64_t lo, hi;
+      delta_bounds_(vals, lo, hi);
+      std::vector<uint64_t> deltas(vals.size());
+      for (size_t i = 1; i < vals.size(); i++)
+      {
+        deltas[i] = (int64_t)vals[i] - vals[i - 1] - lo;
+      }
+      int64_t first = vals.empty() ? 0 : vals[0];
+      ser.write_bytes(&first, sizeof(first));
+      write_packed_(ser, lo, deltas, bit_width(hi - lo));
+      break;
+    }
+    case ENCODING_RLE:
+    {
+      std::vector<int> values;
+      std::vector<uint32_t> lengths;
+      for (size_t i = 0; i < vals.size(); i++)
+      {
+        if (i == 0 || vals[i] != vals[i - 1])
+        {
+          values.push_back(vals[i]);
+          lengths.push_back(0);
+        }
+        lengths.back()++;
+      }
+      ser.write_size_t(values.size());
+      ser.write_bytes(values.data(), values.size() * sizeof(int));
+      ser.write_bytes(lengths.data(), lengths.size() * sizeof(uint32_t));
+      break;
+    }
+    default:
+      throw std::runtime_error("bad chunk encoding!");
+    }
+  }
+
+  /**
+   * Decodes n values written by encode into out, which must have room for
+   * them, and returns the number of payload bytes read. The payload must
+   * be 8-byte aligned.
+   */
+  static size_t decode(uint8_t encoding, const char *payload, size_t n, int *out)
+  {
+    uint32_t *res = reinterpret_cast<uint32_t *>(out);
+    const int64_t *fields = reinterpret_cast<const int64_t *>(payload);
+    switch (encoding)
+    {
+    case ENCODING_PLAIN:
+      memcpy(out, payload, n * sizeof(int));
+      return n * sizeof(int);
+    case ENCODING_FOR:
+    {
+      uint64_t width = fields[1];
+      unpack(reinterpret_cast<const uint64_t *>(fields + 2), n, width, (uint32_t)fields[0], res);
+      return 16 + 8 * packed_words(n, width);
+    }
+    case ENCODING_DELTA:
+    {
+      uint64_t width = fields[2];
+      unpack(reinterpret_cast<const uint64_t *>(fields + 3), n, width, (uint32_t)fields[1], res);
+      uint32_t prev = (uint32_t)fields[0];
+      for (size_t i = 0; i < n; i++)
+      {
+        prev = i == 0 ? prev : prev + res[i];
+        res[i] = prev;
+      }
+      return 24 + 8 * packed_words(n, width);
+    }
+    case ENCODING_RLE:
+    {
+      size_t runs = fields[0];
+      const int *values = reinterpret_cast<const int *>(payload + 8);
+      const uint32_t *lengths = reinterpret_cast<const uint32_t *>(values + runs);
+      size_t i = 0;
+      for (size_t r = 0; r < runs; r++)
+      {
+        for (uint32_t j = 0; j < lengths[r]; j++)
+        {
+          out[i++] = values[r];
+        }
+      }
+      return 8 + 8 * runs;
+    }
+    default:
+      throw std::runtime_error("bad chunk encoding!");
+    }
+  }
+
+private:
+  /** Writes base and width, then the packed values */
+  static void write_packed_(Serializer &ser, int64_t base, const std::vector<uint64_t> &vals, uint64_t width)
+  {
+    ser.write_bytes(&base, sizeof(base));
+    ser.write_bytes(&width, sizeof(width));
+    std::vector<uint64_t> words = pack(vals, width);
+    ser.write_bytes(words.data(), words.size() * sizeof(uint64_t));
+  }
+
+  /** The smallest and largest of vals, 0 and 0 if there are none */
+  static void bounds_(const std::vector<int> &vals, int64_t &lo, int64_t &hi)
+  {
+    lo = hi = vals.empty() ? 0 : vals[0];
+    for (int v : vals)
+    {
+      lo = v < lo ? v : lo;
+      hi = v > hi ? v : hi;
+    }
+  }
+
+  /** The smallest and largest difference between neighbouring values */
+  static void delta_bounds_(const std::vector<int> &vals, int64_t &lo, int64_t &hi)
+  {
+    lo = hi = vals.size() < 2 ? 0 : (int64_t)vals[1] - vals[0];
+    for (size_t i = 1; i < vals.size(); i++)
+    {
+      int64_t d = (int64_t)vals[i] - vals[i - 1];
+      lo = d < lo ? d : lo;
+      hi = d > hi ? d : hi;
+    }
+  }
+};
+
+/**
+ * BitWriter::
+ * Appends values of up to 64 bits to a growing array of words, least
+ * significant bit first.
+ */
+class BitWriter
+{
+public:
+  std::vector<uint64_t> words_;
+  size_t pos_ = 0; // number of bits written
+
+  /** Appends the low nbits of v, whose other bits must be zero. */
+  void write(uint64_t v, size_t nbits)
+  {
+    if (nbits == 0)
+    {
+      return;
+    }
+    size_t off = pos_ % 64;
+    if (off == 0)
+    {
+      words_.push_back(0);
+    }
+    words_.back() |= v << off;
+    if (off + nbits > 64)
+    {
+      words_.push_back(v >> (64 - off));
+    }
+    pos_ += nbits;
+  }
+};
+
+/**
+ * BitReader::
+ * Reads back the values written by a BitWriter, in order.
+ */
+class BitReader
+{
+public:
+  const uint64_t *words_;
+  size_t pos_ = 0; // number of bits read
+
+  BitReader(const uint64_t *words) : words_(words) {}
+
+  /** Reads the next nbits as an unsigned value. */
+  uint64_t read(size_t nbits)
+  {
+    if (nbits == 0)
+    {
+      return 0;
+    }
+    size_t off = pos_ % 64;
+    uint64_t v = words_[pos_ / 64] >> off;
+    if (off + nbits > 64)
+    {
+      v |= words_[pos_ / 64 + 1] << (64 - off);
+    }
+    pos_ += nbits;
+    return nbits == 64 ? v : v & ((1ULL << nbits) - 1);
+  }
+};
+
+/**
+ * DoubleCodecs::
+ * XOR compression for double chunk payloads, as in Facebook's Gorilla.
+ *
+ * The first value is stored whole. Every later value is XORed with the one
+ * before it, and since neighbouring values of a slowly varying series share
+ * their sign, exponent and high mantissa bits, the XOR is mostly zeros:
+ *
+ *   '0'                      the value repeats
+ *   '10' bits                the XOR's set bits fit the previous window,
+ *                            whose bits are stored
+ *   '11' lead(5) len(6) bits a new window: leading zeros, length - 1, bits
+ *
+ * The payload is the number of words followed by the words. Decoding is a
+ * single pass over the bits that writes a plain array of doubles.
+ */
+class DoubleCodecs
+{
+public:
+  /** XOR-encodes vals into packed words. */
+  static std::vector<uint64_t> encode_xor(const std::vector<double> &vals)
+  {
+    BitWriter out;
+    uint64_t prev = 0;
+    size_t lead_prev = 64; // no window yet
+    size_t trail_prev = 0;
+    for (size_t i = 0; i < vals.size(); i++)
+    {
+      uint64_t cur;
+      memcpy(&cur, &vals[i], sizeof(cur));
+      if (i == 0)
+      {
+        out.write(cur, 64);
+        prev = cur;
+        continue;
+      }
+      uint64_t x = cur ^ prev;
+      prev = cur;
+      if (x == 0)
+      {
+        out.write(0, 1);
+        continue;
+      }
+      size_t lead = __builtin_clzll(x);
+      lead = lead > 31 ? 31 : lead;
+      size_t trail = __builtin_ctzll(x);
+      if (lead_prev < 64 && lead >= lead_prev && trail >= trail_prev)
+      {
+        out.write(1, 2); // '1' then '0'
+        out.write(x >> trail_prev, 64 - lead_prev - trail_prev);
+      }
+      else
+      {
+        size_t len = 64 - lead - trail;
+        out.write(3, 2); // '1' then '1'
+        out.write(lead, 5);
+        out.write(len - 1, 6);
+        out.write(x >> trail, len);
+        lead_prev = lead;
+        trail_prev = trail;
+      }
+    }
+    return out.words_;
+  }
+
+  /** Decodes n values from words written by encode_xor into out. */
+  static void decode_xor(const uint64_t *words, size_t n, double *out)
+  {
+    BitReader in(words);
+    uint64_t prev = 0;
+    size_t lead = 0;
+    size_t trail = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (i == 0)
+      {
+        prev = in.read(64);
+      }
+      else if (in.read(1) == 1)
+      {
+        if (in.read(1) == 1)
+        {
+          lead = in.read(5);
+          trail = 64 - lead - (in.read(6) + 1);
+        }
+        prev ^= in.read(64 - lead - trail) << trail;
+      }
+      memcpy(&out[i], &prev, sizeof(prev));
+    }
+  }
+
+  /** Writes vals with the given encoding, PLAIN or XOR. */
+  static void encode(uint8_t encoding, const std::vector<double> &vals, const std::vector<uint64_t> &xor_words,
+                     Serializer &ser)
+  {
+    if (encoding == ENCODING_XOR)
+    {
+      ser.write_size_t(xor_words.size());
+      ser.write_bytes(xor_words.data(), xor_words.size() * sizeof(uint64_t));
+    }
+    else
+    {
+      ser.write_bytes(vals.data(), vals.size() * sizeof(double));
+    }
+  }
+
+  /** Decodes n values written by encode into out, and returns the number
+   * of payload bytes read. The payload must be 8-byte aligned. */
+  static size_t decode(uint8_t encoding, const char *payload, size_t n, double *out)
+  {
+    switch (encoding)
+    {
+    case ENCODING_PLAIN:
+      memcpy(out, payload, n * sizeof(double));
+      return n * sizeof(double);
+    case ENCODING_XOR:
+    {
+      const uint64_t *words = reinterpret_cast<const uint64_t *>(payload);
+      decode_xor(words + 1, n, out);
+      return 8 + 8 * words[0];
+    }
+    default:
+      throw std::runtime_error("bad chunk encoding!");
+    }
+  }
+};
@@ -6,19 +6,30 @@
 // lang::Cpp
 
 #pragma once
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <type_traits>
 #include <vector>
 #include <cassert>
 #include <cmath>
 #include "../kvstore/kvstore.h"
 #include "../util/serial.h"
+#include "../util/span.h"
+#include "../util/string_arena.h"
 #include "chunk.h"
+#include "chunk_view.h"
+#include "column_traits.h"
+#include "kernels.h"
+#include "placement.h"
+#include "zone_map.h"
 
 class IntColumn;
 class BoolColumn;
 class DoubleColumn;
 class StringColumn;
 
+// Largest number of rows in a chunk, whatever its size in bytes
 const size_t MAX_CHUNK_SIZE = 10 * 1000;
 
 /**************************************************************************
@@ -32,11 +43,21 @@ class Column
 public:
   // Keys to the values that contain this column's chunks
   std::vector<Key> keys_;
+  // Zone map of each stored chunk, recorded when it is stored
+  std::vector<ChunkStats> stats_;
+  // Serialized size of each stored chunk (estimated for chunks stored in
+  // the background), used to send work to the node holding the most data
+  std::vector<size_t> sizes_;
+  // Row index of the first row of each stored chunk, followed by that of
+  // the first row of the cache. Chunks vary in length (see ChunkSizing).
+  std::vector<size_t> offsets_ = {0};
+  // Decides which node each chunk is stored on
+  std::shared_ptr<PlacementPolicy> placement_ = std::make_shared<RoundRobinPlacement>();
   // number of elements in this column
   size_t sz_;
-  // Vector of indices that contain missing values attempting to access a value
-  // at an index here has undefined behavior
-  std::vector<size_t> missing_; // TODO: serialize this
+  // Validity of the values in the subclass's cache (the chunk that has not
+  // been stored yet). Stored chunks carry their own validity bitmap.
+  Bitmap cached_validity_;
 
   Column() { sz_ = 0; }
 
@@ -64,434 +85,773 @@ public:
 
   virtual void serialize(Serializer &ser) {}
 
-  // referenced from https://stackoverflow.com/a/440240 on 29MAR20, 2:10pm
-  /** Generates a random (unique) name for a key */
-  virtual std::string gen_name_()
+  /** Stores the given chunk in the store by serializing it, on the node
+   * chosen by this column's placement policy. */
+  virtual void store_chunk(ColumnChunk &chunk, std::shared_ptr<KVStore> store)
   {
-    const int len = 100;
-    std::string ret = "";
-    static const char alphanum[] =
-        "0123456789"
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz";
+    Serializer ser;
+    chunk.serialize(ser);
+    Key k = place_chunk_(chunk, ser.length(), store);
+    store->put(k, Value(ser.data(), ser.length()));
+  }
 
-    for (int i = 0; i < len; ++i)
+  /**
+   * Stores the given chunk through the node's FlushPipeline: the chunk is
+   * placed and recorded in this column now, and serialized and put in the
+   * background. The placement policy is given bytes, an estimate of the
+   * chunk's serialized size, since it is not encoded yet. The job holds on
+   * to the store, so the chunk is put even if the store's other owners let
+   * go of it first.
+   */
+  void store_chunk_async(std::shared_ptr<ColumnChunk> chunk, size_t bytes, std::shared_ptr<KVStore> store)
+  {
+    Key k = place_chunk_(*chunk, bytes, store);
+    store->mark_pending(k);
+    auto job = [chunk, k, store]() {
+      try
+      {
+        Serializer ser;
+        chunk->serialize(ser);
+        store->put(k, Value(ser.data(), ser.length()));
+      }
+      catch (...)
+      {
+        store->unmark_pending(k);
+        throw;
+      }
+    };
+    try
+    {
+      store->flusher_.submit(job);
+    }
+    catch (...)
     {
-      ret += alphanum[rand() % (sizeof(alphanum) - 1)];
+      store->unmark_pending(k);
+      throw;
     }
-    return ret;
   }
 
-  /** Stores the given chunk in the store by serializing it. */
-  virtual void store_chunk(ColumnChunk &chunk, std::shared_ptr<KVStore> store)
+  /** Returns the number of chunks, counting the cache if it is not empty. */
+  size_t num_chunks() { return keys_.size() + (sz_ > offsets_.back() ? 1 : 0); }
+
+  /** Returns the first row of chunk chunk_idx; chunk keys_.size() is the
+   * cache, and later chunks start at the end of the column. */
+  size_t chunk_start(size_t chunk_idx) { return chunk_idx < offsets_.size() ? offsets_[chunk_idx] : sz_; }
+
+  /** Returns the index of the chunk holding row idx, keys_.size() for the
+   * cache, by binary search of the row offsets. */
+  size_t find_chunk(size_t idx)
   {
-    Serializer ser;
-    chunk.serialize(ser);
-    std::string keyName = gen_name_();
-    size_t node = (sz_ / MAX_CHUNK_SIZE) % store->num_nodes();
-    auto k = std::make_shared<Key>(keyName, node);
-    auto v = std::make_shared<Value>(ser.data(), ser.length());
-    store->put(*k, *v);
-    keys_.push_back(*k);
+    if (idx >= offsets_.back())
+    {
+      return keys_.size();
+    }
+    return std::upper_bound(offsets_.begin(), offsets_.end(), idx) - offsets_.begin() - 1;
   }
 
   /**
-   * Serializes this column's keys and size. Subclasses are responsible for 
-   * serializing their caches, because each column subclass has caches of
-   * different types.
+   * Chooses the node for a chunk of the given serialized size with this
+   * column's placement policy, records the chunk's key, zone map and rows,
+   * and returns the key.
    */
-  virtual void serialize_help(Serializer &ser)
+  Key place_chunk_(ColumnChunk &chunk, size_t bytes, std::shared_ptr<KVStore> &store)
   {
-    ser.write_size_t(keys_.size());
-    for (auto key : keys_)
+    ChunkId id = store->new_chunk_id();
+    ChunkPlacement info = {id, keys_.size(), offsets_.back(), bytes, store->idx_, store->num_nodes()};
+    size_t node = placement_->place(info);
+    if (node >= store->num_nodes())
     {
-      key.serialize(ser);
+      throw std::runtime_error("chunk placed on a node that does not exist!");
     }
+    Key k(id, node);
+    keys_.push_back(k);
+    stats_.push_back(chunk.stats());
+    sizes_.push_back(bytes);
+    offsets_.push_back(offsets_.back() + chunk.size());
+    return k;
   }
 
   /**
-   * Deserializes this column's keys and size. Subclasses are responsible for
-   * deserializing their caches because they are of different types.
+   * Serializes this column's keys, and the row count, size and zone map of each
+   * of its chunks. Subclasses are responsible for serializing their caches,
+   * because each column subclass has caches of different types.
    */
-  static std::vector<Key> deserialize_help(Deserializer &dser)
+  virtual void serialize_help(Serializer &ser)
   {
-    size_t num_chunks = dser.read_size_t();
-    std::vector<Key> arr;
-    for (size_t i = 0; i < num_chunks; i++)
+    ser.write_size_t(keys_.size());
+    for (size_t i = 0; i < keys_.size(); i++)
     {
-      arr.push_back(*Key::deserialize(dser));
+      keys_[i].serialize(ser);
+      ser.write_size_t(offsets_[i + 1] - offsets_[i]);
+      ser.write_size_t(sizes_[i]);
+      stats_[i].serialize(ser);
     }
-    return arr;
   }
 
   /**
-   * Marks the given index as containing a missing value. The value at this index
-   * is garbage from here on out.
+   * Deserializes what serialize_help wrote into this (empty) column. The
+   * subclass then deserializes its cache and sets sz_.
    */
-  virtual void mark_missing(size_t idx)
+  void deserialize_help(Deserializer &dser)
   {
-    missing_.push_back(idx);
+    size_t num_chunks = dser.read_size_t();
+    for (size_t i = 0; i < num_chunks; i++)
+    {
+      keys_.push_back(*Key::deserialize(dser));
+      offsets_.push_back(offsets_.back() + dser.read_size_t());
+      sizes_.push_back(dser.read_size_t());
+      stats_.push_back(ChunkStats::deserialize(dser));
+    }
   }
 
   /**
-   * Checks if the given index is a missing value, returning true if so.
+   * Adds to bytes[n], for each node n, the bytes of this column's rows in
+   * [start, end) that are stored on n, prorating each chunk by the share of
+   * its rows in the range. Rows in the cache are on every node and are not
+   * counted. bytes must have an entry per node.
    */
-  virtual bool is_missing(size_t idx)
+  void add_bytes_by_node(size_t start, size_t end, std::vector<size_t> &bytes)
   {
-    for (size_t i = 0; i < missing_.size(); ++i)
+    end = std::min(end, offsets_.back());
+    for (size_t i = start < end ? find_chunk(start) : keys_.size(); i < keys_.size() && offsets_[i] < end; i++)
     {
-      if (idx == missing_[i])
-      {
-        return true;
-      }
+      size_t rows = offsets_[i + 1] - offsets_[i];
+      size_t overlap = std::min(end, offsets_[i + 1]) - std::max(start, offsets_[i]);
+      bytes.at(keys_[i].home_) += sizes_[i] * overlap / rows;
     }
-    return false;
   }
-};
-
-/*************************************************************************
- * BoolColumn::
- * Holds bool values.
- */
-class BoolColumn : public Column
-{
-public:
-  std::vector<bool> cached_chunk_;
-  // The most recently accessed column-chunk. Chunk_idx -> ColumnChunk
-  // TODO: Serialize this
-  std::pair<int, std::shared_ptr<BoolColumnChunk>> external_cached_chunk_ =
-      std::make_pair<int, std::shared_ptr<BoolColumnChunk>>(-1, std::make_shared<BoolColumnChunk>());
 
-public:
-  BoolColumn() = default;
+  /**
+   * Returns false if no present value of stored chunk chunk_idx can be in
+   * [lo, hi], judging by its zone map alone.
+   */
+  bool chunk_may_match(size_t chunk_idx, double lo, double hi) { return stats_.at(chunk_idx).overlaps(lo, hi); }
 
-  BoolColumn(std::vector<Key> keys, std::vector<bool> cache)
+  /**
+   * Returns an estimate of the number of distinct present values in this
+   * column's stored chunks, merged from their zone maps without fetching
+   * them. Values still in the cache are not counted.
+   */
+  size_t distinct_estimate()
   {
-    keys_ = keys;
-    cached_chunk_ = cache;
-    sz_ = keys.size() * MAX_CHUNK_SIZE + cache.size();
+    DistinctSketch sketch;
+    for (auto &stats : stats_)
+    {
+      sketch.merge(stats.distinct_);
+    }
+    return sketch.estimate();
   }
 
-  virtual ~BoolColumn() { keys_.clear(); }
-
   /**
-   * Given absolute idx value, return the value in cache if it exists. Else,
-   * query the KVStore for the correct chunk, and retrieve the value there.
+   * Returns a view of the stored chunk at chunk_idx. Chunks are looked up in
+   * the node's chunk cache first; on a miss, a prefetch of the chunk is
+   * waited for, and otherwise the chunk is retrieved from the KVStore (and
+   * cached). Chunk_idx must be less than keys_.size().
    */
-  bool get(size_t idx, std::shared_ptr<KVStore> store)
+  virtual std::shared_ptr<ColumnChunkView> get_chunk_(size_t chunk_idx, std::shared_ptr<KVStore> store)
   {
-    assert(idx < sz_);
-    size_t chunk_idx = idx / MAX_CHUNK_SIZE;
-    size_t element_idx = idx % MAX_CHUNK_SIZE;
-    if (chunk_idx == keys_.size())
+    Key &k = keys_.at(chunk_idx);
+    auto chunk = store->chunk_cache_.get(k);
+    if (!chunk && store->prefetcher_.wait(k))
     {
-      return cached_chunk_.at(element_idx);
+      // the chunk was being prefetched, and is now cached unless evicted
+      chunk = store->chunk_cache_.get(k);
     }
-    else if ((int)chunk_idx == external_cached_chunk_.first)
+    if (!chunk)
     {
-      return external_cached_chunk_.second->get(element_idx);
+      Value v = store->waitAndGet(k);
+      chunk = std::make_shared<ColumnChunkView>(v);
+      store->chunk_cache_.put(k, chunk, chunk->byte_size());
     }
-    else
+    return chunk;
+  }
+
+  /**
+   * Starts fetching up to n stored chunks from chunk first on, in the
+   * background, into the node's ChunkCache (see Prefetcher). Chunks homed
+   * on this node, already cached or already being fetched are skipped.
+   */
+  void prefetch_(size_t first, size_t n, std::shared_ptr<KVStore> &store)
+  {
+    for (size_t i = first; i < keys_.size() && i < first + n; i++)
     {
-      Value v = store->get(keys_.at(chunk_idx));
-      Deserializer dser(v.data(), v.length());
-      auto bcc = BoolColumnChunk::deserialize(dser);
-      external_cached_chunk_ =
-          std::pair<int, std::shared_ptr<BoolColumnChunk>>(chunk_idx, bcc);
-      auto ret = bcc->get(element_idx);
-      return ret;
+      prefetch_chunk_(i, store);
     }
   }
 
-  BoolColumn *as_bool() { return this; }
+  /** Starts fetching stored chunk chunk_idx, as prefetch_ does. */
+  void prefetch_chunk_(size_t chunk_idx, std::shared_ptr<KVStore> &store)
+  {
+    const Key &k = keys_[chunk_idx];
+    if (k.home_ == store->idx_ || store->chunk_cache_.contains(k))
+    {
+      return;
+    }
+    // the prefetcher is owned by the store, so it cannot outlive it
+    KVStore *s = store.get();
+    store->prefetcher_.fetch(k, [k, s]() {
+      Key key = k;
+      Value v;
+      while (!s->try_get_remote(key, v, Prefetcher::REPLY_WAIT_MS))
+      {
+        if (s->prefetcher_.stopping())
+        {
+          return;
+        }
+        Thread::sleep(1);
+      }
+      auto chunk = std::make_shared<ColumnChunkView>(v);
+      s->chunk_cache_.put(k, chunk, chunk->byte_size());
+    });
+  }
 
-  virtual char get_type() { return 'B'; }
+  /**
+   * Marks the given index as containing a missing value. The value at this index
+   * is garbage from here on out. Only values still in the cache can be marked,
+   * stored chunks are immutable.
+   */
+  virtual void mark_missing(size_t idx)
+  {
+    assert(idx >= offsets_.back());
+    cached_validity_.set(idx - offsets_.back(), false);
+  }
 
   /**
-   * Inserts element into cache. If cache is full, serialize it and store it in
-   * the KV store, and empty the cache.
+   * Checks if the given index is a missing value, returning true if so.
+   * Consults the validity bitmap of the chunk holding idx.
    */
-  virtual void push_back(bool b, std::shared_ptr<KVStore> store)
+  virtual bool is_missing(size_t idx, std::shared_ptr<KVStore> store)
   {
-    if (cached_chunk_.size() >= MAX_CHUNK_SIZE)
+    assert(idx < sz_);
+    size_t chunk_idx = find_chunk(idx);
+    size_t element_idx = idx - chunk_start(chunk_idx);
+    if (chunk_idx == keys_.size())
     {
-      BoolColumnChunk chunk(cached_chunk_);
-      store_chunk(chunk, store); // TODO: Distribute these chunks among all nodes
-      cached_chunk_.clear();
+      return !cached_validity_.test(element_idx);
     }
-    cached_chunk_.push_back(b);
-    sz_++;
+    return get_chunk_(chunk_idx, store)->is_missing(element_idx);
   }
 
-  void serialize(Serializer &ser)
-  {
-    serialize_help(ser);
-    ser.write_bool_vector(cached_chunk_);
-  }
+  /** Returns the number of values in this column, missing or not. */
+  size_t count() { return sz_; }
 
-  static std::shared_ptr<BoolColumn> deserialize(Deserializer &dser)
+  /** Returns the number of values in this column that are not missing. */
+  size_t count_non_missing(std::shared_ptr<KVStore> store) { return sz_ - null_count(store); }
+
+  /**
+   * Returns the number of missing values in this column, read from the zone
+   * maps of the stored chunks, so no chunk is fetched.
+   */
+  virtual size_t null_count(std::shared_ptr<KVStore> store)
   {
-    auto arr = Column::deserialize_help(dser);
-    std::vector<bool> cache = dser.read_bool_vector();
-    return std::make_shared<BoolColumn>(arr, cache);
+    size_t res = cached_validity_.size() - cached_validity_.count();
+    for (auto &stats : stats_)
+    {
+      res += stats.null_count_;
+    }
+    return res;
   }
 };
 
 /*************************************************************************
- * IntColumn::
- * Holds int values.
+ * TypedColumn::
+ * The parts of a column that only depend on its element type T, described
+ * by ColumnTraits<T>: the cache, reading single values, scanning chunks and
+ * storing full caches as chunks. They are compiled once per type, so scans
+ * over a typed column need no virtual calls or type switches. There is one
+ * subclass per element type, adding the operations specific to it.
  */
-class IntColumn : public Column
+template <typename T>
+class TypedColumn : public Column
 {
 public:
-  std::vector<int> cached_chunk_;
-  // The most recently accessed column-chunk. Chunk_idx -> ColumnChunk
-  std::pair<int, std::shared_ptr<IntColumnChunk>> external_cached_chunk_ =
-      std::make_pair<int, std::shared_ptr<IntColumnChunk>>(-1, std::make_shared<IntColumnChunk>());
+  using Traits = ColumnTraits<T>;
+  using Storage = typename Traits::Storage;
+  using Values = typename Traits::Values;
 
-public:
-  IntColumn() = default;
+  Storage cached_chunk_;
 
-  IntColumn(std::vector<Key> keys, std::vector<int> cache)
-  {
-    keys_ = keys;
-    cached_chunk_ = cache;
-    sz_ = keys.size() * MAX_CHUNK_SIZE + cache.size();
-  }
+  TypedColumn() = default;
 
-  virtual ~IntColumn() { keys_.clear(); }
+  char get_type() { return Traits::TYPE; }
 
   /**
    * Given absolute idx value, return the value in cache if it exists. Else,
    * query the KVStore for the correct chunk, and retrieve the value there.
+   * Strings are copied out, since the chunk holding them may be evicted
+   * from the chunk cache at any time; use a ColumnCursor or for_each_chunk
+   * to read strings without copying them.
    */
-  int get(size_t idx, std::shared_ptr<KVStore> store)
+  T get(size_t idx, std::shared_ptr<KVStore> store)
   {
     assert(idx < sz_);
-    size_t chunk_idx = idx / MAX_CHUNK_SIZE;
-    size_t element_idx = idx % MAX_CHUNK_SIZE;
+    size_t chunk_idx = find_chunk(idx);
+    size_t element_idx = idx - chunk_start(chunk_idx);
     if (chunk_idx == keys_.size())
     {
-      return cached_chunk_.at(element_idx);
+      return T(Traits::get(cached_chunk_, element_idx));
     }
-    else if ((int)chunk_idx == external_cached_chunk_.first)
+    return T(Traits::chunk_get(*get_chunk_(chunk_idx, store), element_idx));
+  }
+
+  /**
+   * Calls fn(vals, validity, start) once per chunk of this column, in order,
+   * where vals holds the chunk's values (see ColumnTraits::Values),
+   * validity says which of them are present, and start is the row index of
+   * vals[0]. Values at missing indices are garbage. The values, and the
+   * strings they view, are only valid during the call.
+   */
+  template <typename F>
+  void for_each_chunk(std::shared_ptr<KVStore> store, F fn)
+  {
+    std::vector<std::string_view> scratch;
+    for (size_t i = 0; i < keys_.size(); i++)
     {
-      return external_cached_chunk_.second->get(element_idx);
+      prefetch_(i + 1, store->prefetcher_.readahead_, store);
+      auto chunk = get_chunk_(i, store);
+      fn(Traits::chunk_values(*chunk, scratch), chunk->validity(), offsets_[i]);
     }
-    else
+    if (cached_chunk_.size() > 0)
     {
-      Value v = store->get(keys_.at(chunk_idx));
-      Deserializer dser(v.data(), v.length());
-      auto chunk = IntColumnChunk::deserialize(dser);
-      external_cached_chunk_ =
-          std::pair<int, std::shared_ptr<IntColumnChunk>>(chunk_idx, chunk);
-      return chunk->get(element_idx);
+      fn(Traits::values(cached_chunk_, scratch), cached_validity_.view(), offsets_.back());
     }
   }
 
-  IntColumn *as_int() { return this; }
+  /**
+   * Like for_each_chunk, but skips the stored chunks whose zone maps show
+   * that none of their present values is in [lo, hi]. Skipped chunks are
+   * not fetched, so a range predicate over sorted or clustered data only
+   * moves the chunks it can match. Chunks that are visited may still hold
+   * values outside the range. Only int and double columns have ranges.
+   * Readahead, like for_each_chunk's, fetches the next chunks that can
+   * match, passing over the skipped ones.
+   */
+  template <typename F>
+  void for_each_chunk_in_range(T lo, T hi, std::shared_ptr<KVStore> store, F fn)
+  {
+    static_assert(std::is_same_v<T, int> || std::is_same_v<T, double>, "range scans need an int or double column");
+    std::vector<std::string_view> scratch;
+    for (size_t i = 0; i < keys_.size(); i++)
+    {
+      if (chunk_may_match(i, lo, hi))
+      {
+        size_t ahead = 0;
+        for (size_t j = i + 1; j < keys_.size() && ahead < store->prefetcher_.readahead_; j++)
+        {
+          if (chunk_may_match(j, lo, hi))
+          {
+            prefetch_chunk_(j, store);
+            ahead++;
+          }
+        }
+        auto chunk = get_chunk_(i, store);
+        fn(Traits::chunk_values(*chunk, scratch), chunk->validity(), offsets_[i]);
+      }
+    }
+    if (cached_chunk_.size() > 0)
+    {
+      fn(Traits::values(cached_chunk_, scratch), cached_validity_.view(), offsets_.back());
+    }
+  }
 
-  virtual char get_type() { return 'I'; }
+  /** Returns the number of present values in [lo, hi]. */
+  size_t count_in_range(T lo, T hi, std::shared_ptr<KVStore> store)
+  {
+    size_t res = 0;
+    for_each_chunk_in_range(lo, hi, store, [&](Values vals, BitmapView validity, size_t start) {
+      for (size_t i = 0; i < vals.size(); i++)
+      {
+        res += validity.test(i) && vals[i] >= lo && vals[i] <= hi;
+      }
+    });
+    return res;
+  }
 
   /**
-   * Inserts element into cache. If cache is full, serialize it and store it in
-   * the KV store, and empty the cache.
+   * Inserts element into cache. If cache is full (see ChunkSizing),
+   * serialize it and store it in the KV store, and empty the cache.
    */
-  virtual void push_back(int i, std::shared_ptr<KVStore> store)
+  void push_back(T val, std::shared_ptr<KVStore> store)
   {
-    if (cached_chunk_.size() >= MAX_CHUNK_SIZE)
+    if (cache_full_(store))
     {
-      IntColumnChunk chunk(cached_chunk_);
-      store_chunk(chunk, store);
-      cached_chunk_.clear();
+      flush_(store);
     }
-    cached_chunk_.push_back(i);
+    Traits::push_back(cached_chunk_, val);
+    cached_validity_.push_back(true);
     sz_++;
   }
 
-  void serialize(Serializer &ser)
+  /**
+   * Appends vals, all present, at the end of the column. Chunks are cut
+   * and stored exactly as if each value had been pushed back, but the
+   * values are copied into the cache a run at a time. U is T, or for
+   * string columns anything a std::string_view can be made from.
+   */
+  template <typename U>
+  void append(Span<const U> vals, std::shared_ptr<KVStore> store)
   {
-    serialize_help(ser);
-    ser.write_int_vector(cached_chunk_);
+    append(vals, BitmapView(nullptr, vals.size()), store);
   }
 
-  static std::shared_ptr<IntColumn> deserialize(Deserializer &dser)
+  /** Appends vals, of which those whose bits are cleared in validity (of
+   * the same size) are missing. */
+  template <typename U>
+  void append(Span<const U> vals, BitmapView validity, std::shared_ptr<KVStore> store)
   {
-    auto arr = Column::deserialize_help(dser);
-    std::vector<int> cache = dser.read_int_vector();
-    return std::make_shared<IntColumn>(arr, cache);
+    size_t i = 0;
+    while (i < vals.size())
+    {
+      if (cache_full_(store))
+      {
+        flush_(store);
+      }
+      size_t room = std::min(vals.size() - i, MAX_CHUNK_SIZE - cached_chunk_.size());
+      size_t n = Traits::append(cached_chunk_, vals.data() + i, room, store->chunk_sizing_.target(Traits::TYPE));
+      if (validity.all())
+      {
+        cached_validity_.append(BitmapView(nullptr, n));
+      }
+      else
+      {
+        for (size_t j = i; j < i + n; j++)
+        {
+          cached_validity_.push_back(validity.test(j));
+        }
+      }
+      sz_ += n;
+      i += n;
+    }
   }
-};
-
-/*************************************************************************
- * DoubleColumn::
- * Holds double values.
- */
-class DoubleColumn : public Column
-{
-public:
-  std::vector<double> cached_chunk_;
-  // The most recently accessed column-chunk. Chunk_idx -> ColumnChunk
-  std::pair<int, std::shared_ptr<DoubleColumnChunk>> external_cached_chunk_ =
-      std::make_pair<int, std::shared_ptr<DoubleColumnChunk>>(-1, std::make_shared<DoubleColumnChunk>());
 
-public:
-  DoubleColumn() = default;
-
-  DoubleColumn(std::vector<Key> keys, std::vector<double> cache)
+  void serialize(Serializer &ser)
   {
-    keys_ = keys;
-    cached_chunk_ = cache;
-    sz_ = keys.size() * MAX_CHUNK_SIZE + cache.size();
+    serialize_help(ser);
+    Traits::serialize(ser, cached_chunk_);
+    cached_validity_.serialize(ser);
   }
 
-  virtual ~DoubleColumn() { keys_.clear(); }
+protected:
+  /** Returns true if the cache has to be stored before it takes another
+   * value (see ChunkSizing). */
+  bool cache_full_(std::shared_ptr<KVStore> &store)
+  {
+    return cached_chunk_.size() >= MAX_CHUNK_SIZE ||
+           Traits::byte_size(cached_chunk_) >= store->chunk_sizing_.target(Traits::TYPE);
+  }
 
-  /**
-   * Given absolute idx value, return the value in cache if it exists. Else,
-   * query the KVStore for the correct chunk, and retrieve the value there.
-   */
-  double get(size_t idx, std::shared_ptr<KVStore> store)
+  /** Stores the cache as a chunk, in the background if the node's
+   * FlushPipeline is asynchronous, and empties it. */
+  void flush_(std::shared_ptr<KVStore> &store)
   {
-    assert(idx < sz_);
-    size_t chunk_idx = idx / MAX_CHUNK_SIZE;
-    size_t element_idx = idx % MAX_CHUNK_SIZE;
-    if (chunk_idx == keys_.size())
+    if (store->flusher_.async())
     {
-      return cached_chunk_.at(element_idx);
-    }
-    else if ((int)chunk_idx == external_cached_chunk_.first)
-    {
-      return external_cached_chunk_.second->get(element_idx);
+      size_t bytes = Traits::byte_size(cached_chunk_);
+      auto chunk = std::make_shared<typename Traits::Chunk>(std::move(cached_chunk_), std::move(cached_validity_));
+      store_chunk_async(chunk, bytes, store);
     }
     else
     {
-      Value v = store->waitAndGet(keys_.at(chunk_idx));
-      Deserializer dser(v.data(), v.length());
-      auto chunk = DoubleColumnChunk::deserialize(dser);
-      external_cached_chunk_ =
-          std::pair<int, std::shared_ptr<DoubleColumnChunk>>(chunk_idx, chunk);
-      return chunk->get(element_idx);
+      typename Traits::Chunk chunk(cached_chunk_, cached_validity_);
+      store_chunk(chunk, store);
     }
+    cached_chunk_.clear();
+    cached_validity_.clear();
   }
 
-  DoubleColumn *as_double() { return this; }
+  /** Deserializes a column serialized by serialize, as subclass C. */
+  template <typename C>
+  static std::shared_ptr<C> deserialize_(Deserializer &dser)
+  {
+    auto res = std::make_shared<C>();
+    res->deserialize_help(dser);
+    res->cached_chunk_ = Traits::deserialize(dser);
+    res->cached_validity_ = Bitmap::deserialize(dser);
+    res->sz_ = res->offsets_.back() + res->cached_chunk_.size();
+    return res;
+  }
+};
 
-  virtual char get_type() { return 'D'; }
+/*************************************************************************
+ * BoolColumn::
+ * Holds bool values, packed 64 to a word.
+ */
+class BoolColumn : public TypedColumn<bool>
+{
+public:
+  using TypedColumn::TypedColumn;
 
   /**
-   * Inserts element into cache. If cache is full, serialize it and store it in
-   * the KV store, and empty the cache.
+   * Returns a bitmap over every row of the column with the bits of the rows
+   * that are present and true set, built a word at a time. It can be used to
+   * filter the rows of a dataframe.
    */
-  virtual void push_back(double d, std::shared_ptr<KVStore> store)
+  Bitmap mask(std::shared_ptr<KVStore> store)
   {
-    if (cached_chunk_.size() >= MAX_CHUNK_SIZE)
-    {
-      DoubleColumnChunk chunk(cached_chunk_);
-      store_chunk(chunk, store);
-      cached_chunk_.clear();
-    }
-    cached_chunk_.push_back(d);
-    sz_++;
+    Bitmap res;
+    for_each_chunk(store, [&](BitmapView vals, BitmapView validity, size_t /*start*/) {
+      Bitmap chunk(std::vector<uint64_t>(vals.words_, vals.words_ + (vals.size() + 63) / 64), vals.size());
+      chunk.and_with(validity);
+      res.append(chunk.view());
+    });
+    return res;
   }
 
-  void serialize(Serializer &ser)
+  /** Returns the number of present values that are true, by popcount. */
+  size_t count_true(std::shared_ptr<KVStore> store)
   {
-    serialize_help(ser);
-    ser.write_double_vector(cached_chunk_);
+    size_t res = 0;
+    for_each_chunk(store, [&](BitmapView vals, BitmapView validity, size_t /*start*/) {
+      for (size_t w = 0; w < (vals.size() + 63) / 64; w++)
+      {
+        res += __builtin_popcountll(vals.word(w) & validity.word(w));
+      }
+    });
+    return res;
   }
 
-  static std::shared_ptr<DoubleColumn> deserialize(Deserializer &dser)
+  /** Returns the number of present values that are false. */
+  size_t count_false(std::shared_ptr<KVStore> store) { return count_non_missing(store) - count_true(store); }
+
+  BoolColumn *as_bool() { return this; }
+
+  static std::shared_ptr<BoolColumn> deserialize(Deserializer &dser) { return deserialize_<BoolColumn>(dser); }
+};
+
+/*************************************************************************
+ * IntColumn::
+ * Holds int values.
+ */
+class IntColumn : public TypedColumn<int>
+{
+public:
+  using TypedColumn::TypedColumn;
+
+  /**
+   * Folds every present value of this column into an aggregate, a chunk at a
+   * time, with the SIMD kernels in kernels.h.
+   */
+  IntAggregate aggregate(std::shared_ptr<KVStore> store)
   {
-    auto arr = Column::deserialize_help(dser);
-    std::vector<double> cache = dser.read_double_vector();
-    return std::make_shared<DoubleColumn>(arr, cache);
+    IntAggregate agg;
+    for_each_chunk(store, [&](Span<const int> vals, BitmapView validity, size_t /*start*/) {
+      Kernels::aggregate(vals.data(), vals.size(), validity, agg);
+    });
+    return agg;
   }
+
+  /** Aggregates over the present values of this column. The min and max of a
+   * column without present values are undefined, and its mean is NaN. */
+  long sum(std::shared_ptr<KVStore> store) { return aggregate(store).sum_; }
+
+  int min(std::shared_ptr<KVStore> store) { return aggregate(store).min_; }
+
+  int max(std::shared_ptr<KVStore> store) { return aggregate(store).max_; }
+
+  double mean(std::shared_ptr<KVStore> store)
+  {
+    IntAggregate agg = aggregate(store);
+    return agg.count_ == 0 ? NAN : (double)agg.sum_ / agg.count_;
+  }
+
+  IntColumn *as_int() { return this; }
+
+  static std::shared_ptr<IntColumn> deserialize(Deserializer &dser) { return deserialize_<IntColumn>(dser); }
 };
 
 /*************************************************************************
- * StringColumn::
- * Holds string pointers. The strings are external.  Nullptr is a valid
- * value.
+ * DoubleColumn::
+ * Holds double values.
  */
-class StringColumn : public Column
+class DoubleColumn : public TypedColumn<double>
 {
 public:
-  std::vector<std::string> cached_chunk_;
-  // The most recently accessed column-chunk. Chunk_idx -> ColumnChunk
-  std::pair<int, std::shared_ptr<StringColumnChunk>> external_cached_chunk_ =
-      std::make_pair<int, std::shared_ptr<StringColumnChunk>>(-1, std::make_shared<StringColumnChunk>());
+  using TypedColumn::TypedColumn;
 
-public:
-  StringColumn() = default;
+  /**
+   * Folds every present value of this column into an aggregate, a chunk at a
+   * time, with the SIMD kernels in kernels.h.
+   */
+  DoubleAggregate aggregate(std::shared_ptr<KVStore> store)
+  {
+    DoubleAggregate agg;
+    for_each_chunk(store, [&](Span<const double> vals, BitmapView validity, size_t /*start*/) {
+      Kernels::aggregate(vals.data(), vals.size(), validity, agg);
+    });
+    return agg;
+  }
+
+  /** Aggregates over the present values of this column. The min and max of a
+   * column without present values are undefined, and its mean is NaN. */
+  double sum(std::shared_ptr<KVStore> store) { return aggregate(store).sum_; }
+
+  double min(std::shared_ptr<KVStore> store) { return aggregate(store).min_; }
+
+  double max(std::shared_ptr<KVStore> store) { return aggregate(store).max_; }
 
-  StringColumn(std::vector<Key> keys, std::vector<std::string> cache)
+  double mean(std::shared_ptr<KVStore> store)
   {
-    keys_ = keys;
-    cached_chunk_ = cache;
-    sz_ = keys.size() * MAX_CHUNK_SIZE + cache.size();
+    DoubleAggregate agg = aggregate(store);
+    return agg.count_ == 0 ? NAN : (double)agg.sum_ / agg.count_;
   }
 
-  virtual ~StringColumn() { keys_.clear(); }
+  DoubleColumn *as_double() { return this; }
+
+  static std::shared_ptr<DoubleColumn> deserialize(Deserializer &dser) { return deserialize_<DoubleColumn>(dser); }
+};
+
+/*************************************************************************
+ * StringColumn::
+ * Holds string values. The cache keeps its strings in a StringArena, as
+ * stored chunks do.
+ */
+class StringColumn : public TypedColumn<std::string>
+{
+public:
+  using TypedColumn::TypedColumn;
 
   /**
-   * Given absolute idx value, return the value in cache if it exists. Else,
-   * query the KVStore for the correct chunk, and retrieve the value there.
+   * Returns a bitmap over every row of the column with the bits of the rows
+   * that are present and equal to str set. Dictionary-encoded chunks look
+   * str up once and then compare codes; chunks whose dictionary does not
+   * hold str are skipped without looking at their values.
    */
-  std::string get(size_t idx, std::shared_ptr<KVStore> store)
+  Bitmap match(std::string_view str, std::shared_ptr<KVStore> store)
   {
-    assert(idx < sz_);
-    size_t chunk_idx = idx / MAX_CHUNK_SIZE;
-    size_t element_idx = idx % MAX_CHUNK_SIZE;
-    if (chunk_idx == keys_.size())
-    {
-      return cached_chunk_.at(element_idx);
-    }
-    else if (int(chunk_idx) == external_cached_chunk_.first)
+    Bitmap res;
+    for (size_t i = 0; i < keys_.size(); i++)
     {
-      return external_cached_chunk_.second->get(element_idx);
+      auto chunk = get_chunk_(i, store);
+      Bitmap bits(chunk->size(), false);
+      if (chunk->is_dict())
+      {
+        long code = chunk->find_code(str);
+        for (size_t j = 0; code >= 0 && j < chunk->size(); j++)
+        {
+          if (chunk->codes_[j] == (uint32_t)code)
+          {
+            bits.set(j, true);
+          }
+        }
+      }
+      else
+      {
+        for (size_t j = 0; j < chunk->size(); j++)
+        {
+          if (chunk->get_string(j) == str)
+          {
+            bits.set(j, true);
+          }
+        }
+      }
+      bits.and_with(chunk->validity());
+      res.append(bits.view());
     }
-    else
+    Bitmap bits(cached_chunk_.size(), false);
+    for (size_t j = 0; j < cached_chunk_.size(); j++)
     {
-      Value v = store->get(keys_.at(chunk_idx));
-      Deserializer dser(v.data(), v.length());
-      auto chunk = StringColumnChunk::deserialize(dser);
-      external_cached_chunk_ =
-          std::pair<int, std::shared_ptr<StringColumnChunk>>(chunk_idx, chunk);
-      return chunk->get(element_idx);
+      bits.set(j, cached_chunk_.get(j) == str);
     }
+    bits.and_with(cached_validity_.view());
+    res.append(bits.view());
+    return res;
   }
 
+  /** Returns the number of present values equal to str. */
+  size_t count_equal(std::string_view str, std::shared_ptr<KVStore> store) { return match(str, store).count(); }
+
   StringColumn *as_string() { return this; }
 
-  virtual char get_type() { return 'S'; }
+  static std::shared_ptr<StringColumn> deserialize(Deserializer &dser) { return deserialize_<StringColumn>(dser); }
+};
 
-  /**
-   * Inserts element into cache. If cache is full, serialize it and store it in
-   * the KV store, and empty the cache.
-   */
-  virtual void push_back(std::string s, std::shared_ptr<KVStore> store)
+/*************************************************************************
+ * ColumnCursor::
+ * Reads the rows of one column, keeping the chunk under the cursor pinned.
+ * Reads that stay within the pinned chunk go straight to its view instead
+ * of through the node's chunk cache, so a scan takes the cache lock once
+ * per chunk rather than once per value. A cursor that moves from a chunk to
+ * the next prefetches the remote chunks after it (see Prefetcher). A cursor
+ * is cheap to create and is not thread-safe; each thread scanning a column
+ * uses its own.
+ */
+class ColumnCursor
+{
+public:
+  Column *col_;
+  std::shared_ptr<KVStore> store_;
+  std::shared_ptr<ColumnChunkView> chunk_; // pinned chunk, nullptr on the cache
+  size_t begin_ = 0;                       // first row under the cursor
+  size_t end_ = 0;                         // one past the last row under the cursor
+  size_t chunk_idx_ = SIZE_MAX;            // chunk under the cursor; SIZE_MAX + 1 wraps to chunk 0,
+                                           // so a first read of chunk 0 counts as reading in order
+
+  ColumnCursor(Column *col, std::shared_ptr<KVStore> store) : col_(col), store_(store) {}
+
+  /** Returns true if the value at row idx is missing. */
+  bool is_missing(size_t idx)
   {
-    if (cached_chunk_.size() >= MAX_CHUNK_SIZE)
-    {
-      StringColumnChunk chunk(cached_chunk_);
-      store_chunk(chunk, store);
-      cached_chunk_.clear();
-    }
-    cached_chunk_.push_back(s);
-    sz_++;
+    seek_(idx);
+    return chunk_ ? chunk_->is_missing(idx - begin_) : !col_->cached_validity_.test(idx - begin_);
   }
 
-  void serialize(Serializer &ser)
+  /** Returns the value at row idx of a column of element type T (strings
+   * as views, valid until the cursor moves to another chunk). The column is
+   * known to be a TypedColumn<T>, so no virtual call is made. Calling it
+   * with the wrong type for the column is undefined. */
+  template <typename T>
+  auto get(size_t idx)
   {
-    serialize_help(ser);
-    ser.write_string_vector(cached_chunk_);
+    seek_(idx);
+    using Traits = ColumnTraits<T>;
+    return chunk_ ? Traits::chunk_get(*chunk_, idx - begin_)
+                  : Traits::get(static_cast<TypedColumn<T> *>(col_)->cached_chunk_, idx - begin_);
   }
 
-  static std::shared_ptr<StringColumn> deserialize(Deserializer &dser)
+  /** Typed getters. Calling the wrong one for the column is undefined. */
+  int get_int(size_t idx) { return get<int>(idx); }
+
+  bool get_bool(size_t idx) { return get<bool>(idx); }
+
+  double get_double(size_t idx) { return get<double>(idx); }
+
+  /** The view is valid until the cursor moves to another chunk. */
+  std::string_view get_string(size_t idx) { return get<std::string>(idx); }
+
+  /** Returns the dictionary code of the string at row idx, or -1 if its
+   * chunk is not dictionary-encoded. */
+  long get_code(size_t idx)
+  {
+    seek_(idx);
+    return chunk_ && chunk_->is_dict() ? (long)chunk_->codes_[idx - begin_] : -1;
+  }
+
+private:
+  /** Moves the cursor onto the chunk holding row idx, if it is not there */
+  void seek_(size_t idx)
   {
-    auto arr = Column::deserialize_help(dser);
-    std::vector<std::string> cache = dser.read_string_vector();
-    return std::make_shared<StringColumn>(arr, cache);
+    assert(idx < col_->size());
+    if (idx >= begin_ && idx < end_)
+    {
+      return;
+    }
+    size_t chunk_idx = col_->find_chunk(idx);
+    begin_ = col_->chunk_start(chunk_idx);
+    if (chunk_idx == chunk_idx_ + 1)
+    {
+      // reading in order: fetch the chunks after this one in the background
+      col_->prefetch_(chunk_idx + 1, store_->prefetcher_.readahead_, store_);
+    }
+    chunk_idx_ = chunk_idx;
+    if (chunk_idx == col_->keys_.size())
+    {
+      chunk_ = nullptr;
+      end_ = col_->size();
+    }
+    else
+    {
+      chunk_ = col_->get_chunk_(chunk_idx, store_);
+      end_ = begin_ + chunk_->size();
+    }
   }
 };
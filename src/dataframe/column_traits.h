@@ -0,0 +1,264 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../util/bitmap.h"
+#include "../util/serial.h"
+#include "../util/span.h"
+#include "../util/string_arena.h"
+#include "zone_map.h"
+
+class IntColumnChunk;
+class BoolColumnChunk;
+class DoubleColumnChunk;
+class StringColumnChunk;
+
+/**
+ * ColumnTraits::
+ *
+ * Everything the column and chunk templates (TypedColumn, TypedColumnChunk)
+ * need to know about one element type, resolved at compile time: its
+ * schema character, how a run of values is stored in memory, how the values
+ * of a stored chunk are read back, and which chunk class serializes them.
+ * Adding a column type means adding a specialization here, a chunk class
+ * with its serialization, and the type's getter on ColumnChunkView.
+ *
+ * Value is the type a single value is read as. Storage is the in-memory
+ * representation of a chunk's values (and of a column's cache);
+ * byte_size is roughly how large it serializes, and append adds a run of
+ * values to it up to a byte target. Values is what for_each_chunk hands
+ * out for a chunk, and value_at reads one of them; building it for strings
+ * needs a scratch vector of views, which the other types ignore. The
+ * view-reading functions are templates so that this header does not depend
+ * on ColumnChunkView.
+ */
+template <typename T>
+struct ColumnTraits;
+
+template <>
+struct ColumnTraits<int>
+{
+  static constexpr char TYPE = 'I';
+  using Value = int;
+  using Storage = std::vector<int>;
+  using Values = Span<const int>;
+  using Chunk = IntColumnChunk;
+
+  static int get(const Storage &vals, size_t idx) { return vals[idx]; }
+
+  static void push_back(Storage &vals, int val) { vals.push_back(val); }
+
+  static size_t byte_size(const Storage &vals) { return vals.size() * sizeof(int); }
+
+  /** Appends up to n of vals, fewer if the storage reaches target bytes
+   * first, and returns how many were appended (at least one). */
+  template <typename U>
+  static size_t append(Storage &vals, const U *src, size_t n, size_t target)
+  {
+    size_t full = (target + sizeof(vals[0]) - 1) / sizeof(vals[0]);
+    n = std::min(n, full > vals.size() ? full - vals.size() : 1);
+    vals.insert(vals.end(), src, src + n);
+    return n;
+  }
+
+  static Values values(const Storage &vals, std::vector<std::string_view> &) { return Values(vals.data(), vals.size()); }
+
+  static int value_at(const Values &vals, size_t idx) { return vals[idx]; }
+
+  template <typename View>
+  static int chunk_get(View &chunk, size_t idx) { return chunk.get_int(idx); }
+
+  template <typename View>
+  static Values chunk_values(View &chunk, std::vector<std::string_view> &) { return Values(chunk.ints(), chunk.size()); }
+
+  /** Adds present value idx to a zone map. */
+  static void add_stats(ChunkStats &stats, const Storage &vals, size_t idx)
+  {
+    stats.add_to_range(vals[idx]);
+    stats.distinct_.add_hash(DistinctSketch::hash((uint32_t)vals[idx]));
+  }
+
+  static void serialize(Serializer &ser, const Storage &vals) { ser.write_int_vector(vals); }
+
+  static Storage deserialize(Deserializer &dser) { return dser.read_int_vector(); }
+};
+
+template <>
+struct ColumnTraits<double>
+{
+  static constexpr char TYPE = 'D';
+  using Value = double;
+  using Storage = std::vector<double>;
+  using Values = Span<const double>;
+  using Chunk = DoubleColumnChunk;
+
+  static double get(const Storage &vals, size_t idx) { return vals[idx]; }
+
+  static void push_back(Storage &vals, double val) { vals.push_back(val); }
+
+  static size_t byte_size(const Storage &vals) { return vals.size() * sizeof(double); }
+
+  /** Appends up to n of vals, fewer if the storage reaches target bytes
+   * first, and returns how many were appended (at least one). */
+  template <typename U>
+  static size_t append(Storage &vals, const U *src, size_t n, size_t target)
+  {
+    size_t full = (target + sizeof(vals[0]) - 1) / sizeof(vals[0]);
+    n = std::min(n, full > vals.size() ? full - vals.size() : 1);
+    vals.insert(vals.end(), src, src + n);
+    return n;
+  }
+
+  static Values values(const Storage &vals, std::vector<std::string_view> &) { return Values(vals.data(), vals.size()); }
+
+  static double value_at(const Values &vals, size_t idx) { return vals[idx]; }
+
+  template <typename View>
+  static double chunk_get(View &chunk, size_t idx) { return chunk.get_double(idx); }
+
+  template <typename View>
+  static Values chunk_values(View &chunk, std::vector<std::string_view> &) { return Values(chunk.doubles(), chunk.size()); }
+
+  /** NaNs are left out of the range, since they compare false with
+   * everything and so never match a range predicate. */
+  static void add_stats(ChunkStats &stats, const Storage &vals, size_t idx)
+  {
+    uint64_t bits;
+    memcpy(&bits, &vals[idx], sizeof(bits));
+    stats.distinct_.add_hash(DistinctSketch::hash(bits));
+    if (!std::isnan(vals[idx]))
+    {
+      stats.add_to_range(vals[idx]);
+    }
+  }
+
+  static void serialize(Serializer &ser, const Storage &vals) { ser.write_double_vector(vals); }
+
+  static Storage deserialize(Deserializer &dser) { return dser.read_double_vector(); }
+};
+
+/** Bools are packed 64 to a word, so their values are a BitmapView. */
+template <>
+struct ColumnTraits<bool>
+{
+  static constexpr char TYPE = 'B';
+  using Value = bool;
+  using Storage = Bitmap;
+  using Values = BitmapView;
+  using Chunk = BoolColumnChunk;
+
+  static bool get(const Storage &vals, size_t idx) { return vals.test(idx); }
+
+  static void push_back(Storage &vals, bool val) { vals.push_back(val); }
+
+  static size_t byte_size(const Storage &vals) { return (vals.size() + 7) / 8; }
+
+  /** Appends up to n of vals, fewer if the storage reaches target bytes
+   * first, and returns how many were appended (at least one). */
+  template <typename U>
+  static size_t append(Storage &vals, const U *src, size_t n, size_t target)
+  {
+    size_t i = 0;
+    while (i < n && (i == 0 || byte_size(vals) < target))
+    {
+      push_back(vals, src[i++]);
+    }
+    return i;
+  }
+
+  static Values values(const Storage &vals, std::vector<std::string_view> &) { return vals.view(); }
+
+  static bool value_at(const Values &vals, size_t idx) { return vals.test(idx); }
+
+  template <typename View>
+  static bool chunk_get(View &chunk, size_t idx) { return chunk.get_bool(idx); }
+
+  template <typename View>
+  static Values chunk_values(View &chunk, std::vector<std::string_view> &) { return chunk.bools(); }
+
+  static void add_stats(ChunkStats &stats, const Storage &vals, size_t idx)
+  {
+    stats.add_to_range(vals.test(idx));
+    stats.distinct_.add_hash(DistinctSketch::hash(vals.test(idx)));
+  }
+
+  static void serialize(Serializer &ser, const Storage &vals) { vals.serialize(ser); }
+
+  static Storage deserialize(Deserializer &dser) { return Bitmap::deserialize(dser); }
+};
+
+/** Strings are kept in a StringArena and read as views into it. */
+template <>
+struct ColumnTraits<std::string>
+{
+  static constexpr char TYPE = 'S';
+  using Value = std::string_view;
+  using Storage = StringArena;
+  using Values = Span<const std::string_view>;
+  using Chunk = StringColumnChunk;
+
+  static std::string_view get(const Storage &vals, size_t idx) { return vals.get(idx); }
+
+  static void push_back(Storage &vals, std::string_view val) { vals.push_back(val); }
+
+  static size_t byte_size(const Storage &vals) { return vals.bytes_.size() + vals.offsets_.size() * sizeof(uint64_t); }
+
+  /** Appends up to n of vals, fewer if the storage reaches target bytes
+   * first, and returns how many were appended (at least one). */
+  template <typename U>
+  static size_t append(Storage &vals, const U *src, size_t n, size_t target)
+  {
+    size_t i = 0;
+    while (i < n && (i == 0 || byte_size(vals) < target))
+    {
+      push_back(vals, src[i++]);
+    }
+    return i;
+  }
+
+  static Values values(const Storage &vals, std::vector<std::string_view> &scratch)
+  {
+    scratch.clear();
+    for (size_t i = 0; i < vals.size(); i++)
+    {
+      scratch.push_back(vals.get(i));
+    }
+    return Values(scratch.data(), scratch.size());
+  }
+
+  static std::string_view value_at(const Values &vals, size_t idx) { return vals[idx]; }
+
+  template <typename View>
+  static std::string_view chunk_get(View &chunk, size_t idx) { return chunk.get_string(idx); }
+
+  template <typename View>
+  static Values chunk_values(View &chunk, std::vector<std::string_view> &scratch)
+  {
+    scratch.clear();
+    for (size_t i = 0; i < chunk.size(); i++)
+    {
+      scratch.push_back(chunk.get_string(i));
+    }
+    return Values(scratch.data(), scratch.size());
+  }
+
+  /** Strings have no range, only distinct values. */
+  static void add_stats(ChunkStats &stats, const Storage &vals, size_t idx)
+  {
+    stats.distinct_.add_hash(DistinctSketch::hash(std::hash<std::string_view>()(vals.get(idx))));
+  }
+
+  static void serialize(Serializer &ser, const Storage &vals) { vals.serialize(ser); }
+
+  static Storage deserialize(Deserializer &dser) { return StringArena::deserialize(dser); }
+};
@@ -7,16 +7,21 @@
 
 #pragma once
 
+#include <limits>
 #include <thread>
 #include "column.h"
 #include "fielder.h"
+#include "group_by.h"
 #include "row.h"
 #include "rower.h"
 #include "schema.h"
+#include "selection.h"
 #include "wrapper.h"
 #include "../util/reader.h"
 #include "../util/writer.h"
 
+class GroupBy;
+
 /****************************************************************************
  * DataFrame::
  *
@@ -89,6 +94,17 @@ public:
     }
   }
 
+  /** Makes every column of this dataframe store its chunks where policy
+   * says, sharing the policy (see PlacementPolicy). Only chunks stored from
+   * now on are affected. */
+  void set_placement(std::shared_ptr<PlacementPolicy> policy)
+  {
+    for (auto &col : cols_)
+    {
+      col->placement_ = policy;
+    }
+  }
+
   /** Add a row at the end of this dataframe. The row is expected to have
    *  the right schema and be filled with values, otherwise undefined.  */
   void add_row(Row &row, std::shared_ptr<KVStore> store)
@@ -147,32 +163,16 @@ public:
    */
   void fill_row(size_t idx, Row &row, std::shared_ptr<KVStore> store)
   {
-    for (size_t i = 0; i < ncols(); i++)
-    {
-      auto col = cols_.at(i);
-      if (col->is_missing(idx))
-      {
-        row.set_missing(i);
-      }
-      else
-      {
-        switch (col->get_type())
-        {
-        case 'B':
-          row.set(i, Bool(col->as_bool()->get(idx, store)));
-          break;
-        case 'I':
-          row.set(i, Int(col->as_int()->get(idx, store)));
-          break;
-        case 'D':
-          row.set(i, Double(col->as_double()->get(idx, store)));
-          break;
-        case 'S':
-          row.set(i, String(col->as_string()->get(idx, store)));
-          break;
-        }
-      }
-    }
+    fill_row(idx, row, {}, store);
+  }
+
+  /** Like fill_row, but only reads (and fetches the chunks of) the given
+   * columns, leaving the other fields of row unchanged. An empty list of
+   * columns means every column. */
+  void fill_row(size_t idx, Row &row, const std::vector<size_t> &cols, std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    fill_row_(idx, row, cursors, projection_(cols));
   }
 
   /** The number of rows in the dataframe. */
@@ -181,28 +181,223 @@ public:
   /** The number of columns in the dataframe.*/
   size_t ncols() { return schema_.width(); }
 
-  /** Visit rows in order */
+  /** Visit rows in order. Only the columns r declares (see
+   * Rower::columns) are read. */
   void map(Rower &r, std::shared_ptr<KVStore> store)
   {
-    for (size_t i = 0; i < nrows(); ++i)
+    map_range_(r, 0, nrows(), r.columns(), store);
+  }
+
+  /** Visit rows in order, reading only the given columns. An empty list of
+   * columns means every column. */
+  void map(Rower &r, const std::vector<size_t> &cols, std::shared_ptr<KVStore> store)
+  {
+    map_range_(r, 0, nrows(), cols, store);
+  }
+
+  /** Visits, in order, only the rows in sel. Chunks holding no selected row
+   * are never fetched. */
+  void map(Rower &r, const Selection &sel, std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    std::vector<size_t> cols = projection_(r.columns());
+    Row row(schema_);
+    for (size_t i = 0; i < sel.size(); ++i)
     {
-      Row row(schema_);
-      fill_row(i, row, store);
+      fill_row_(sel[i], row, cursors, cols);
       r.accept(row);
     }
   }
 
-  void map(Reader &reader)
+  /**
+   * Returns the ids of the rows that r accepts, visiting every row in order.
+   * The result selects rows of this dataframe and can be passed to map, so
+   * the kept rows are processed in place rather than copied out. A
+   * StringSearchRower is not visited row by row: its string columns are
+   * matched a chunk at a time (see StringColumn::match), comparing
+   * dictionary codes where chunks have them.
+   */
+  Selection filter(Rower &r, std::shared_ptr<KVStore> store)
+  {
+    std::vector<size_t> cols = projection_(r.columns());
+    if (auto search = dynamic_cast<StringSearchRower *>(&r))
+    {
+      Bitmap matches(nrows(), false);
+      for (size_t col : cols)
+      {
+        if (schema_.col_type(col) == 'S')
+        {
+          matches.or_with(cols_.at(col)->as_string()->match(search->_search_str, store).view());
+        }
+      }
+      return Selection(matches.view());
+    }
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    Row row(schema_);
+    Selection res;
+    for (size_t i = 0; i < nrows(); ++i)
+    {
+      fill_row_(i, row, cursors, cols);
+      if (r.accept(row))
+      {
+        res.push_back(i);
+      }
+    }
+    return res;
+  }
+
+  /**
+   * Returns the ids of the rows whose value in column col satisfies pred.
+   * T is the type of the column: int, bool, double or std::string_view. The
+   * column is scanned a chunk at a time and no row is built, so this is much
+   * cheaper than filtering with a Rower. Missing values never satisfy pred.
+   * Asking for the wrong type throws.
+   */
+  template <typename T, typename P>
+  Selection filter(size_t col, P pred, std::shared_ptr<KVStore> store)
+  {
+    // string columns are TypedColumn<std::string>, read as views
+    using E = std::conditional_t<std::is_same_v<T, std::string_view>, std::string, T>;
+    using Traits = ColumnTraits<E>;
+    std::shared_ptr<Column> c = cols_.at(col);
+    if (c->get_type() != Traits::TYPE)
+    {
+      throw std::runtime_error("filter on a column of the wrong type!");
+    }
+    Selection res;
+    static_cast<TypedColumn<E> *>(c.get())->for_each_chunk(
+        store, [&](typename Traits::Values vals, BitmapView validity, size_t start) {
+          for (size_t i = 0; i < vals.size(); i++)
+          {
+            if (validity.test(i) && pred(Traits::value_at(vals, i)))
+            {
+              res.push_back(start + i);
+            }
+          }
+        });
+    return res;
+  }
+
+  /** Groups the rows by their values in the given key columns, for
+   * aggregation (see GroupBy). This dataframe must outlive the result. */
+  GroupBy group_by(std::vector<size_t> key_cols);
+
+  /**
+   * Visit rows in parallel. The rows are split at the chunk boundaries of
+   * the first column into up to THREAD_COUNT contiguous ranges, one per
+   * thread. The first range is
+   * visited by r and every other range by a clone of r; the clones are then
+   * joined into r in range order, so the result does not depend on thread
+   * scheduling. Rowers that cannot be cloned (clone returns nullptr) are
+   * run serially, as by map.
+   */
+  void pmap(Rower &r, std::shared_ptr<KVStore> store)
+  {
+    size_t num_chunks = ncols() == 0 ? 0 : cols_.at(0)->num_chunks();
+    size_t num_threads = std::min((size_t)THREAD_COUNT, num_chunks);
+    if (num_threads <= 1)
+    {
+      map(r, store);
+      return;
+    }
+    std::vector<std::shared_ptr<Rower>> clones;
+    for (size_t t = 1; t < num_threads; t++)
+    {
+      auto clone = r.clone();
+      if (!clone)
+      {
+        map(r, store);
+        return;
+      }
+      clones.push_back(clone);
+    }
+
+    // thread t visits chunks [t * num_chunks / num_threads, (t + 1) * ...)
+    auto range_start = [&](size_t t) {
+      return cols_.at(0)->chunk_start(t * num_chunks / num_threads);
+    };
+    std::vector<size_t> cols = r.columns();
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++)
+    {
+      threads.emplace_back([this, &clones, &range_start, &cols, t, store]() {
+        map_range_(*clones.at(t - 1), range_start(t), range_start(t + 1), cols, store);
+      });
+    }
+    map_range_(r, range_start(0), range_start(1), cols, store);
+    for (auto &thread : threads)
+    {
+      thread.join();
+    }
+    for (auto &clone : clones)
+    {
+      r.join_delete(clone);
+    }
+  }
+
+  /**
+   * Visits, in order, the rows of this dataframe that this node is assigned,
+   * and joins the results of every node on node 0. The work goes to the
+   * data: each node of the cluster calls map on its copy of the same
+   * dataframe, scans only its own rows, and only the readers' serialized
+   * results cross the network.
+   *
+   * Rows are split into ranges at the chunk boundaries of the first column,
+   * and each range is assigned to the node that stores the most bytes of it
+   * across the columns the reader reads (see assign_range_). The columns of
+   * a range are not always on one node, since columns are cut into chunks
+   * differently (see ChunkSizing) and placed separately; a RowRangePlacement
+   * keeps them together, so that every read is local. Every copy of the
+   * dataframe computes the same assignment.
+   *
+   * Every node must make the same sequence of map calls, since they are
+   * matched up by the order they are made in. The call is a barrier: node 0
+   * waits for the result of every other node (see join_map_), so a node
+   * that skips a map deadlocks node 0. On return, node 0's reader holds the
+   * result for the whole dataframe (joined in node order) and the readers on
+   * the other nodes hold the results for their own rows.
+   */
+  void map(Reader &reader, std::shared_ptr<KVStore> store)
   {
-    // TODO for m5
+    size_t this_node = store->idx_;
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    std::vector<size_t> cols = projection_(reader.columns());
+    Row row(schema_);
+    size_t num_ranges = ncols() == 0 ? 0 : cols_.at(0)->keys_.size() + 1;
+    for (size_t i = 0; i < num_ranges; i++)
+    {
+      size_t start = cols_.at(0)->chunk_start(i);
+      size_t end = std::min(nrows(), cols_.at(0)->chunk_start(i + 1));
+      if (start >= end || assign_range_(start, end, cols, store->num_nodes()) != this_node)
+      {
+        continue;
+      }
+      for (size_t j = start; j < end; j++)
+      {
+        fill_row_(j, row, cursors, cols);
+        reader.visit(row);
+      }
+    }
+    join_map_(reader, store);
   }
 
+  /** Visits every row in order with r, without distributing the work. Only
+   * the columns r declares (see Reader::columns) are read. */
   void local_map(Reader &r, std::shared_ptr<KVStore> store)
   {
+    local_map(r, r.columns(), store);
+  }
+
+  /** Like local_map, but reads only the given columns. An empty list of
+   * columns means every column. */
+  void local_map(Reader &r, const std::vector<size_t> &cols, std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    std::vector<size_t> projected = projection_(cols);
     Row row(schema_);
     for (size_t i = 0; i < nrows(); ++i)
     {
-      fill_row(i, row, store);
+      fill_row_(i, row, cursors, projected);
       r.visit(row);
     }
   }
@@ -210,13 +405,8 @@ public:
   /** Print the dataframe in SoR format to standard output. */
   void print(std::shared_ptr<KVStore> store)
   {
-    auto rower = std::make_shared<PrintRower>();
-    for (size_t i = 0; i < nrows(); ++i)
-    {
-      Row row(schema_);
-      fill_row(i, row, store);
-      rower->accept(row);
-    }
+    PrintRower rower;
+    map(rower, store);
   }
 
   /**
@@ -269,24 +459,8 @@ public:
   }
 
   /** Returns a dataframe with sz values and puts it in the key value store
-   *  under the key */
-  static std::shared_ptr<DataFrame> fromArray(std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::vector<double> vals)
-  {
-    Schema s;
-    auto res = std::make_shared<DataFrame>(s);
-    auto dc = std::make_shared<DoubleColumn>();
-    for (double val : vals)
-    {
-      dc->push_back(val, store);
-    }
-    res->add_column(dc);
-
-    Serializer ser;
-    res->serialize(ser);
-    auto value = std::make_shared<Value>(ser.data(), ser.length());
-    store->put(*key, *value);
-    return res;
-  }
+   *  under the key. The values are appended as one batch. */
+  static std::shared_ptr<DataFrame> fromArray(std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::vector<double> vals);
 
   /** Returns a dataframe with a single scalar double */
   static std::shared_ptr<DataFrame> fromScalar(std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, double val)
@@ -320,26 +494,736 @@ public:
     return res;
   }
 
+  /** Returns a dataframe of the rows count writes until it is done, and
+   *  puts it in the key value store under the key. The rows are gathered
+   *  into column batches (see DataFrameBuilder). */
   static std::shared_ptr<DataFrame> fromVisitor(
-      std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::string col_types, Writer &count)
+      std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::string col_types, Writer &count);
+
+  static std::shared_ptr<DataFrame> fromFile(std::string file, std::shared_ptr<Key> key, std::shared_ptr<KVStore> store)
   {
-    Schema s(col_types.c_str());
-    auto res = std::make_shared<DataFrame>(s);
-    while (!count.done())
+    return std::make_shared<DataFrame>();
+  }
+
+private:
+  /** Returns a fresh cursor over each column of this dataframe. */
+  std::vector<ColumnCursor> make_cursors_(std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors;
+    for (auto &col : cols_)
     {
-      auto row = std::make_shared<Row>(s);
-      count.visit(*row);
-      res->add_row(*row, store);
+      cursors.emplace_back(col.get(), store);
     }
-    Serializer ser;
-    res->serialize(ser);
-    auto value = std::make_shared<Value>(ser.data(), ser.length());
-    store->put(*key, *value);
-    return res;
+    return cursors;
   }
 
-  static std::shared_ptr<DataFrame> fromFile(std::string file, std::shared_ptr<Key> key, std::shared_ptr<KVStore> store)
+  /** Returns cols, or every column of this dataframe if cols is empty.
+   * Throws if a column is out of bounds. */
+  std::vector<size_t> projection_(const std::vector<size_t> &cols)
   {
-    return std::make_shared<DataFrame>();
+    if (cols.empty())
+    {
+      std::vector<size_t> res(ncols());
+      for (size_t i = 0; i < ncols(); i++)
+      {
+        res[i] = i;
+      }
+      return res;
+    }
+    for (size_t col : cols)
+    {
+      if (col >= ncols())
+      {
+        throw std::runtime_error("projected column out of bounds!");
+      }
+    }
+    return cols;
+  }
+
+  /** Fills the given columns of row with the values at idx, read through
+   * the given cursors. Cursors only fetch chunks when they are read, so
+   * the chunks of the other columns are never fetched. */
+  void fill_row_(size_t idx, Row &row, std::vector<ColumnCursor> &cursors, const std::vector<size_t> &cols)
+  {
+    for (size_t i : cols)
+    {
+      ColumnCursor &cursor = cursors.at(i);
+      if (cursor.is_missing(idx))
+      {
+        row.set_missing(i);
+      }
+      else
+      {
+        switch (cols_.at(i)->get_type())
+        {
+        case 'B':
+          row.set(i, Bool(cursor.get_bool(idx)));
+          break;
+        case 'I':
+          row.set(i, Int(cursor.get_int(idx)));
+          break;
+        case 'D':
+          row.set(i, Double(cursor.get_double(idx)));
+          break;
+        case 'S':
+          row.set_string(i, cursor.get_string(idx));
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Returns the node that the distributed map assigns rows [start, end):
+   * the one storing the most bytes of those rows in the given columns, the
+   * lowest such node on a tie. Ranges held only in the columns' caches,
+   * which every node has, go to node 0.
+   */
+  size_t assign_range_(size_t start, size_t end, const std::vector<size_t> &cols, size_t num_nodes)
+  {
+    std::vector<size_t> bytes(num_nodes, 0);
+    for (size_t col : cols)
+    {
+      cols_.at(col)->add_bytes_by_node(start, end, bytes);
+    }
+    return std::max_element(bytes.begin(), bytes.end()) - bytes.begin();
+  }
+
+  /**
+   * Publishes this node's result for the current map under a key on node 0,
+   * where it is joined into node 0's reader. Results are keyed by the map's
+   * sequence number and the node they come from ("map-N-i" for map N and
+   * node i). Node 0 blocks until every other node has published, so this is
+   * a barrier that every node must reach.
+   */
+  void join_map_(Reader &reader, std::shared_ptr<KVStore> store)
+  {
+    size_t num_nodes = store->num_nodes();
+    if (num_nodes <= 1)
+    {
+      return;
+    }
+    std::string prefix = "map-" + std::to_string(store->next_map_id_++) + "-";
+    if (store->idx_ != 0)
+    {
+      Serializer ser;
+      reader.serialize(ser);
+      store->put(Key(prefix + std::to_string(store->idx_), 0), Value(ser.data(), ser.length()));
+      return;
+    }
+    for (size_t i = 1; i < num_nodes; i++)
+    {
+      Value v = store->waitAndGet(Key(prefix + std::to_string(i), 0));
+      Deserializer dser(v.data(), v.length());
+      reader.join(dser);
+    }
+  }
+
+  /** Visits rows [start, end) in order with r, reading only the given
+   * columns (all of them if cols is empty). The row object is reused. */
+  void map_range_(Rower &r, size_t start, size_t end, const std::vector<size_t> &cols,
+                  std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors = make_cursors_(store);
+    std::vector<size_t> projected = projection_(cols);
+    Row row(schema_);
+    for (size_t i = start; i < end; ++i)
+    {
+      fill_row_(i, row, cursors, projected);
+      r.accept(row);
+    }
+  }
+};
+
+/****************************************************************************
+ * DataFrameBuilder::
+ *
+ * Builds a DataFrame a column batch at a time. Each batch goes straight to
+ * its column through TypedColumn::append, which copies it into the column's
+ * cache a run at a time and stores chunks as they fill: there is no virtual
+ * call, shared_ptr copy or flush check per value, as there is when adding
+ * rows to a DataFrame. Columns can be filled in any order and in batches of
+ * any size, as long as they end up the same length.
+ *
+ * Loaders that produce rows can add them here too: they are buffered, per
+ * column, into batches of BATCH_ROWS rows.
+ */
+class DataFrameBuilder
+{
+public:
+  static const size_t BATCH_ROWS = 1024;
+
+  /** Values of one column added by add_row and not yet appended. Only the
+   * buffer of the column's type is used. */
+  struct Batch
+  {
+    std::vector<int> ints_;
+    std::vector<double> doubles_;
+    std::unique_ptr<bool[]> bools_;
+    StringArena strings_;
+    Bitmap validity_;
+  };
+
+  std::shared_ptr<DataFrame> df_;   // the dataframe being built
+  std::shared_ptr<KVStore> store_;  // where its chunks are stored
+  std::vector<Batch> batches_;      // buffered rows, by column
+  size_t buffered_ = 0;             // number of rows buffered
+
+  /** Starts an empty dataframe with the columns of schema. */
+  DataFrameBuilder(Schema &schema, std::shared_ptr<KVStore> store)
+      : df_(std::make_shared<DataFrame>(schema)), store_(store), batches_(schema.width())
+  {
+    df_->schema_.nrows_ = 0;
+    for (size_t i = 0; i < batches_.size(); i++)
+    {
+      if (schema.col_type(i) == 'B')
+      {
+        batches_[i].bools_ = std::make_unique<bool[]>(BATCH_ROWS);
+      }
+    }
+  }
+
+  /**
+   * Appends vals, all present, to column col. T is the type of the column:
+   * int, bool, double, or for string columns std::string or
+   * std::string_view. Asking for the wrong type throws.
+   */
+  template <typename T>
+  void append(size_t col, Span<const T> vals)
+  {
+    append(col, vals, BitmapView(nullptr, vals.size()));
+  }
+
+  /** Appends vals to column col, of which those whose bits are cleared in
+   * validity (of the same size) are missing. */
+  template <typename T>
+  void append(size_t col, Span<const T> vals, BitmapView validity)
+  {
+    constexpr bool is_string = std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+    using E = std::conditional_t<is_string, std::string, T>;
+    std::shared_ptr<Column> c = df_->cols_.at(col);
+    if (c->get_type() != ColumnTraits<E>::TYPE)
+    {
+      throw std::runtime_error("batch of the wrong type for the column!");
+    }
+    flush_rows_();
+    static_cast<TypedColumn<E> *>(c.get())->append(vals, validity, store_);
+  }
+
+  /** Adds a row at the end of the dataframe. The row is expected to have
+   *  the right schema, otherwise undefined. */
+  void add_row(Row &row)
+  {
+    for (size_t i = 0; i < batches_.size(); i++)
+    {
+      Batch &b = batches_[i];
+      b.validity_.push_back(!row.is_missing(i));
+      switch (df_->schema_.col_type(i))
+      {
+      case 'B':
+        b.bools_[buffered_] = row.get_bool(i);
+        break;
+      case 'I':
+        b.ints_.push_back(row.get_int(i));
+        break;
+      case 'D':
+        b.doubles_.push_back(row.get_double(i));
+        break;
+      case 'S':
+        b.strings_.push_back(row.get_string_view(i));
+        break;
+      }
+    }
+    if (++buffered_ == BATCH_ROWS)
+    {
+      flush_rows_();
+    }
+  }
+
+  /** Appends whatever rows are buffered, and returns the dataframe. Throws
+   * if its columns are not all the same length. */
+  std::shared_ptr<DataFrame> done()
+  {
+    flush_rows_();
+    size_t nrows = df_->ncols() == 0 ? 0 : df_->cols_[0]->size();
+    for (auto &col : df_->cols_)
+    {
+      if (col->size() != nrows)
+      {
+        throw std::runtime_error("columns of uneven length!");
+      }
+    }
+    df_->schema_.nrows_ = nrows;
+    return df_;
+  }
+
+private:
+  /** Appends the rows buffered by add_row to their columns. */
+  void flush_rows_()
+  {
+    if (buffered_ == 0)
+    {
+      return;
+    }
+    std::vector<std::string_view> views;
+    for (size_t i = 0; i < batches_.size(); i++)
+    {
+      Batch &b = batches_[i];
+      BitmapView validity = b.validity_.all() ? BitmapView(nullptr, buffered_) : b.validity_.view();
+      Column *c = df_->cols_[i].get();
+      switch (c->get_type())
+      {
+      case 'B':
+        static_cast<TypedColumn<bool> *>(c)->append(Span<const bool>(b.bools_.get(), buffered_), validity, store_);
+        break;
+      case 'I':
+        static_cast<TypedColumn<int> *>(c)->append(Span<const int>(b.ints_.data(), buffered_), validity, store_);
+        b.ints_.clear();
+        break;
+      case 'D':
+        static_cast<TypedColumn<double> *>(c)->append(Span<const double>(b.doubles_.data(), buffered_), validity, store_);
+        b.doubles_.clear();
+        break;
+      case 'S':
+        views.clear();
+        for (size_t j = 0; j < buffered_; j++)
+        {
+          views.push_back(b.strings_.get(j));
+        }
+        static_cast<TypedColumn<std::string> *>(c)->append(Span<const std::string_view>(views.data(), buffered_), validity, store_);
+        b.strings_.clear();
+        break;
+      }
+      b.validity_.clear();
+    }
+    buffered_ = 0;
+  }
+};
+
+inline std::shared_ptr<DataFrame> DataFrame::fromArray(std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::vector<double> vals)
+{
+  Schema s("D");
+  DataFrameBuilder builder(s, store);
+  builder.append(0, Span<const double>(vals.data(), vals.size()));
+  auto res = builder.done();
+
+  Serializer ser;
+  res->serialize(ser);
+  auto value = std::make_shared<Value>(ser.data(), ser.length());
+  store->put(*key, *value);
+  return res;
+}
+
+inline std::shared_ptr<DataFrame> DataFrame::fromVisitor(
+    std::shared_ptr<Key> key, std::shared_ptr<KVStore> store, std::string col_types, Writer &count)
+{
+  Schema s(col_types.c_str());
+  DataFrameBuilder builder(s, store);
+  Row row(s);
+  while (!count.done())
+  {
+    for (size_t i = 0; i < row.width(); i++)
+    {
+      row.set_missing(i);
+    }
+    count.visit(row);
+    builder.add_row(row);
+  }
+  auto res = builder.done();
+
+  Serializer ser;
+  res->serialize(ser);
+  auto value = std::make_shared<Value>(ser.data(), ser.length());
+  store->put(*key, *value);
+  return res;
+}
+
+/****************************************************************************
+ * GroupBy::
+ *
+ * The rows of a dataframe grouped by their values in one or more key
+ * columns, made by DataFrame::group_by. agg computes aggregates of each
+ * group with hash aggregation: the rows are split at chunk boundaries into
+ * ranges, as by pmap, and each thread folds its range into its own
+ * GroupTable. The partial tables are then merged in range order, so groups
+ * come out in the order of their first row whatever the scheduling.
+ *
+ * Tables are specialized by key: a single int key column hashes the ints
+ * themselves and a single string column its strings (once per dictionary
+ * code, in dictionary-encoded chunks), while any other key
+ * (several columns, or a bool or double) is encoded into bytes and hashed
+ * as a string. Rows whose key is missing (in every column, for a single
+ * key) form one group, whose key is missing in the result.
+ */
+class GroupBy
+{
+public:
+  DataFrame *df_;
+  std::vector<size_t> keys_; // key columns
+
+  /** Throws if there are no key columns or one is out of bounds. */
+  GroupBy(DataFrame *df, std::vector<size_t> keys) : df_(df), keys_(keys)
+  {
+    if (keys_.empty())
+    {
+      throw std::runtime_error("group by needs a key column!");
+    }
+    for (size_t col : keys_)
+    {
+      if (col >= df_->ncols())
+      {
+        throw std::runtime_error("group key column out of bounds!");
+      }
+    }
+  }
+
+  /**
+   * Returns a new dataframe with a row per group: the group's key columns,
+   * followed by a column per aggregate, in order. Counts are ints, sums and
+   * means doubles, and mins and maxes have the type of their column. Sums of
+   * int columns are accumulated exactly in a long, but columns have no long
+   * type, so they are output as doubles, exact up to 2^53 in magnitude.
+   * Counts are ints, and a count past INT_MAX throws rather than wraps. A
+   * group without present values has a sum of 0 and a missing min, max and
+   * mean. Throws on an aggregate over a column that is out of bounds or not
+   * numeric.
+   */
+  std::shared_ptr<DataFrame> agg(std::vector<Agg> aggs, std::shared_ptr<KVStore> store)
+  {
+    for (Agg &a : aggs)
+    {
+      if (a.op_ == Agg::COUNT && a.col_ == Agg::ROWS)
+      {
+        continue;
+      }
+      if (a.col_ >= df_->ncols())
+      {
+        throw std::runtime_error("aggregated column out of bounds!");
+      }
+      char type = df_->get_schema().col_type(a.col_);
+      if (a.op_ != Agg::COUNT && type != 'I' && type != 'D')
+      {
+        throw std::runtime_error("cannot aggregate a column of that type!");
+      }
+    }
+    if (keys_.size() == 1 && df_->get_schema().col_type(keys_[0]) == 'I')
+    {
+      return agg_<int>(aggs, store);
+    }
+    return agg_<std::string_view>(aggs, store);
+  }
+
+private:
+  /** Returns true if keys are encoded into bytes rather than read as is. */
+  bool encoded_()
+  {
+    char type = df_->get_schema().col_type(keys_[0]);
+    return keys_.size() > 1 || (type != 'I' && type != 'S');
+  }
+
+  template <typename K>
+  std::shared_ptr<DataFrame> agg_(const std::vector<Agg> &aggs, std::shared_ptr<KVStore> store)
+  {
+    size_t num_chunks = df_->cols_.at(0)->num_chunks();
+    size_t num_threads = std::max((size_t)1, std::min((size_t)DataFrame::THREAD_COUNT, num_chunks));
+    // thread t folds chunks [t * num_chunks / num_threads, (t + 1) * ...)
+    auto range_start = [&](size_t t) {
+      return df_->cols_.at(0)->chunk_start(t * num_chunks / num_threads);
+    };
+    std::vector<GroupTable<K>> tables(num_threads, GroupTable<K>(aggs.size()));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++)
+    {
+      threads.emplace_back([this, &tables, &aggs, &range_start, t, store]() {
+        scan_(tables[t], range_start(t), range_start(t + 1), aggs, store);
+      });
+    }
+    scan_(tables[0], range_start(0), num_threads == 1 ? df_->nrows() : range_start(1), aggs, store);
+    for (auto &thread : threads)
+    {
+      thread.join();
+    }
+    for (size_t t = 1; t < num_threads; t++)
+    {
+      tables[0].merge(tables[t]);
+    }
+    return output_(tables[0], aggs, store);
   }
-};
\ No newline at end of file
+
+  /** Folds rows [start, end) into table. */
+  template <typename K>
+  void scan_(GroupTable<K> &table, size_t start, size_t end, const std::vector<Agg> &aggs,
+             std::shared_ptr<KVStore> store)
+  {
+    std::vector<ColumnCursor> cursors;
+    for (auto &col : df_->cols_)
+    {
+      cursors.emplace_back(col.get(), store);
+    }
+    std::vector<char> types;
+    for (const Agg &a : aggs)
+    {
+      types.push_back(a.col_ == Agg::ROWS ? '\0' : df_->get_schema().col_type(a.col_));
+    }
+    bool encoded = encoded_();
+    std::string buf;
+    std::shared_ptr<ColumnChunkView> dict; // dictionary chunk of the last key read
+    std::vector<size_t> dict_groups;        // group of each of its codes, NONE until seen
+    for (size_t row = start; row < end; row++)
+    {
+      size_t g;
+      ColumnCursor &key = cursors[keys_[0]];
+      if constexpr (std::is_same_v<K, int>)
+      {
+        g = key.is_missing(row) ? table.null_group() : table.find_or_add(key.get_int(row));
+      }
+      else if (!encoded)
+      {
+        g = key.is_missing(row) ? table.null_group() : find_string_group_(table, key, row, dict, dict_groups);
+      }
+      else
+      {
+        g = encode_(row, cursors, buf) ? table.find_or_add(std::string_view(buf)) : table.null_group();
+      }
+      AggState *states = table.states(g);
+      for (size_t a = 0; a < aggs.size(); a++)
+      {
+        if (types[a] == '\0')
+        {
+          states[a].count_++;
+          continue;
+        }
+        ColumnCursor &cursor = cursors[aggs[a].col_];
+        if (cursor.is_missing(row))
+        {
+          continue;
+        }
+        switch (types[a])
+        {
+        case 'I':
+          states[a].add(cursor.get_int(row));
+          break;
+        case 'D':
+          states[a].add(cursor.get_double(row));
+          break;
+        default:
+          states[a].count_++;
+        }
+      }
+    }
+  }
+
+  /**
+   * Returns the group of the present string key at row. Keys in a
+   * dictionary-encoded chunk are looked up in table once per code of the
+   * chunk, after which the rows of the chunk map codes to groups directly.
+   */
+  template <typename K>
+  size_t find_string_group_(GroupTable<K> &table, ColumnCursor &key, size_t row,
+                            std::shared_ptr<ColumnChunkView> &dict, std::vector<size_t> &dict_groups)
+  {
+    long code = key.get_code(row);
+    if (code < 0)
+    {
+      return table.find_or_add(key.get_string(row));
+    }
+    if (key.chunk_ != dict)
+    {
+      dict = key.chunk_;
+      dict_groups.assign(dict->dict_size(), GroupTable<K>::NONE);
+    }
+    size_t &g = dict_groups[code];
+    if (g == GroupTable<K>::NONE)
+    {
+      g = table.find_or_add(key.get_string(row));
+    }
+    return g;
+  }
+
+  /**
+   * Encodes the key of row into buf: per key column, a byte that is 1 if the
+   * value is present, and then the value's bytes (strings prefixed by their
+   * length). Returns false if every key value is missing.
+   */
+  bool encode_(size_t row, std::vector<ColumnCursor> &cursors, std::string &buf)
+  {
+    buf.clear();
+    bool any = false;
+    for (size_t col : keys_)
+    {
+      ColumnCursor &cursor = cursors[col];
+      bool present = !cursor.is_missing(row);
+      any |= present;
+      buf.push_back(present);
+      if (!present)
+      {
+        continue;
+      }
+      switch (df_->get_schema().col_type(col))
+      {
+      case 'I':
+      {
+        int v = cursor.get_int(row);
+        buf.append((char *)&v, sizeof(v));
+        break;
+      }
+      case 'D':
+      {
+        double v = cursor.get_double(row);
+        buf.append((char *)&v, sizeof(v));
+        break;
+      }
+      case 'B':
+        buf.push_back(cursor.get_bool(row));
+        break;
+      case 'S':
+      {
+        std::string_view v = cursor.get_string(row);
+        uint32_t len = v.size();
+        buf.append((char *)&len, sizeof(len));
+        buf.append(v.data(), v.size());
+        break;
+      }
+      }
+    }
+    return any;
+  }
+
+  /** Sets the key columns of row from a key encoded by encode_. */
+  void decode_(std::string_view key, Row &row)
+  {
+    const char *p = key.data();
+    for (size_t i = 0; i < keys_.size(); i++)
+    {
+      if (!*p++)
+      {
+        row.set_missing(i);
+        continue;
+      }
+      switch (df_->get_schema().col_type(keys_[i]))
+      {
+      case 'I':
+      {
+        int v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        row.set(i, Int(v));
+        break;
+      }
+      case 'D':
+      {
+        double v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        row.set(i, Double(v));
+        break;
+      }
+      case 'B':
+        row.set(i, Bool(*p++));
+        break;
+      case 'S':
+      {
+        uint32_t len;
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        row.set_string(i, std::string_view(p, len));
+        p += len;
+        break;
+      }
+      }
+    }
+  }
+
+  /** Builds the result dataframe from the merged table. */
+  template <typename K>
+  std::shared_ptr<DataFrame> output_(GroupTable<K> &table, const std::vector<Agg> &aggs, std::shared_ptr<KVStore> store)
+  {
+    Schema s;
+    for (size_t col : keys_)
+    {
+      s.add_column(df_->get_schema().col_type(col));
+    }
+    for (const Agg &a : aggs)
+    {
+      if (a.op_ == Agg::COUNT)
+      {
+        s.add_column('I');
+      }
+      else if (a.op_ == Agg::MIN || a.op_ == Agg::MAX)
+      {
+        s.add_column(df_->get_schema().col_type(a.col_));
+      }
+      else
+      {
+        s.add_column('D');
+      }
+    }
+    DataFrameBuilder builder(s, store);
+    Row row(s);
+    bool encoded = encoded_();
+    for (size_t g = 0; g < table.size(); g++)
+    {
+      if (table.is_null(g))
+      {
+        for (size_t i = 0; i < keys_.size(); i++)
+        {
+          row.set_missing(i);
+        }
+      }
+      else if constexpr (std::is_same_v<K, int>)
+      {
+        row.set(0, Int(table.key(g)));
+      }
+      else if (!encoded)
+      {
+        row.set_string(0, table.key(g));
+      }
+      else
+      {
+        decode_(table.key(g), row);
+      }
+      AggState *states = table.states(g);
+      for (size_t a = 0; a < aggs.size(); a++)
+      {
+        size_t col = keys_.size() + a;
+        AggState &st = states[a];
+        if (aggs[a].op_ == Agg::COUNT)
+        {
+          if (st.count_ > (size_t)std::numeric_limits<int>::max())
+          {
+            throw std::runtime_error("group count does not fit in an int column!");
+          }
+          row.set(col, Int(st.count_));
+        }
+        else if (aggs[a].op_ == Agg::SUM)
+        {
+          row.set(col, Double(st.sum()));
+        }
+        else if (st.count_ == 0)
+        {
+          row.set_missing(col);
+        }
+        else if (aggs[a].op_ == Agg::MEAN)
+        {
+          row.set(col, Double(st.sum() / st.count_));
+        }
+        else
+        {
+          double v = aggs[a].op_ == Agg::MIN ? st.min_ : st.max_;
+          if (s.col_type(col) == 'I')
+          {
+            row.set(col, Int(v));
+          }
+          else
+          {
+            row.set(col, Double(v));
+          }
+        }
+      }
+      builder.add_row(row);
+    }
+    return builder.done();
+  }
+};
+
+inline GroupBy DataFrame::group_by(std::vector<size_t> key_cols) { return GroupBy(this, key_cols); }
@@ -7,6 +7,7 @@
 
 #pragma once
 #include <string>
+#include <string_view>
 
 /*****************************************************************************
  * Fielder::
@@ -21,11 +22,12 @@ public:
     dataframe. */
   virtual void start(size_t r) = 0;
 
-  /** Called for fields of the argument's type with the value of the field. */
+  /** Called for fields of the argument's type with the value of the field.
+   * A string is viewed in place, and is only valid during the call. */
   virtual void accept(bool b) = 0;
   virtual void accept(double f) = 0;
   virtual void accept(int i) = 0;
-  virtual void accept(std::string s) = 0;
+  virtual void accept(std::string_view s) = 0;
 
   /** Called when all fields have been seen. */
   virtual void done() = 0;
@@ -61,7 +63,7 @@ public:
     std::cout << i;
   }
 
-  virtual void accept(std::string s)
+  virtual void accept(std::string_view s)
   {
 
     std::cout << s;
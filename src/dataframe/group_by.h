@@ -0,0 +1,243 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <vector>
+#include "../util/bitmap.h"
+#include "../util/string_arena.h"
+#include "zone_map.h"
+
+/** One aggregate of a group-by (see GroupBy): an operation over a column. */
+struct Agg
+{
+  enum Op
+  {
+    SUM,
+    COUNT,
+    MIN,
+    MAX,
+    MEAN
+  };
+
+  // column of Agg::count() that counts the rows of a group
+  static const size_t ROWS = SIZE_MAX;
+
+  Op op_;      // what to compute
+  size_t col_; // column to compute it over
+
+  /** Sum, min, max and mean are over the present values of an int or double
+   * column. Count is of the present values of any column, or of the rows of
+   * the group if no column is given. */
+  static Agg sum(size_t col) { return {SUM, col}; }
+  static Agg count(size_t col = ROWS) { return {COUNT, col}; }
+  static Agg min(size_t col) { return {MIN, col}; }
+  static Agg max(size_t col) { return {MAX, col}; }
+  static Agg mean(size_t col) { return {MEAN, col}; }
+};
+
+/** The running state of one aggregate of one group. Every aggregate keeps
+ * all of it, so states merge the same way whatever they compute. Int
+ * values are summed exactly, in a long, as IntColumn::sum does, and double
+ * values in a double; a state only ever sees one of the two. */
+struct AggState
+{
+  long isum_ = 0;
+  double sum_ = 0;
+  size_t count_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+
+  void add(int val)
+  {
+    isum_ += val;
+    count_++;
+    min_ = std::min(min_, (double)val);
+    max_ = std::max(max_, (double)val);
+  }
+
+  void add(double val)
+  {
+    sum_ += val;
+    count_++;
+    min_ = std::min(min_, val);
+    max_ = std::max(max_, val);
+  }
+
+  void merge(const AggState &other)
+  {
+    isum_ += other.isum_;
+    sum_ += other.sum_;
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  /** The sum of the values added, whichever their type. */
+  double sum() { return isum_ + sum_; }
+};
+
+/**
+ * GroupKeyTraits::
+ * How a GroupTable stores and hashes keys of type K. Ints are kept in a
+ * vector; string keys, which are views into chunks while a table is built,
+ * are copied into an arena.
+ */
+template <typename K>
+struct GroupKeyTraits;
+
+template <>
+struct GroupKeyTraits<int>
+{
+  using Storage = std::vector<int>;
+
+  static uint64_t hash(int key) { return DistinctSketch::hash((uint32_t)key); }
+
+  static int get(const Storage &keys, size_t idx) { return keys[idx]; }
+
+  static void push_back(Storage &keys, int key) { keys.push_back(key); }
+};
+
+template <>
+struct GroupKeyTraits<std::string_view>
+{
+  using Storage = StringArena;
+
+  static uint64_t hash(std::string_view key) { return DistinctSketch::hash(std::hash<std::string_view>()(key)); }
+
+  static std::string_view get(const Storage &keys, size_t idx) { return keys.get(idx); }
+
+  static void push_back(Storage &keys, std::string_view key) { keys.push_back(key); }
+};
+
+/**
+ * GroupTable::
+ *
+ * The groups of a group-by and their aggregate states, in the order the
+ * groups were first seen. Groups are found by an open-addressing hash table
+ * with linear probing: the slots hold group numbers and the groups' hashes
+ * are kept beside their keys, so a probe compares keys only on a full hash
+ * match and growing never rehashes a key. Rows whose key is missing all go
+ * to one null group, which is not in the slots.
+ */
+template <typename K>
+class GroupTable
+{
+public:
+  using Traits = GroupKeyTraits<K>;
+  static constexpr size_t NONE = SIZE_MAX;
+  static const size_t INITIAL_SLOTS = 16;
+
+  size_t num_aggs_;               // aggregate states per group
+  typename Traits::Storage keys_; // key of each group
+  std::vector<uint64_t> hashes_;  // hash of each group's key
+  Bitmap nulls_;                  // set for the null group
+  std::vector<AggState> states_;  // num_aggs_ states per group
+  std::vector<size_t> slots_;     // group + 1 per slot, 0 if empty
+  size_t null_group_ = NONE;      // the null group, NONE until seen
+
+  GroupTable(size_t num_aggs) : num_aggs_(num_aggs), slots_(INITIAL_SLOTS, 0) {}
+
+  /** Number of groups. */
+  size_t size() { return hashes_.size(); }
+
+  /** Returns the group of key, whose hash is h, adding it if it is new. */
+  size_t find_or_add(K key, uint64_t h)
+  {
+    size_t mask = slots_.size() - 1;
+    size_t i = h & mask;
+    while (slots_[i] != 0)
+    {
+      size_t g = slots_[i] - 1;
+      if (hashes_[g] == h && Traits::get(keys_, g) == key)
+      {
+        return g;
+      }
+      i = (i + 1) & mask;
+    }
+    size_t g = add_(key, h, false);
+    slots_[i] = g + 1;
+    if (2 * size() > slots_.size())
+    {
+      grow_();
+    }
+    return g;
+  }
+
+  size_t find_or_add(K key) { return find_or_add(key, Traits::hash(key)); }
+
+  /** Returns the group of the rows whose key is missing. */
+  size_t null_group()
+  {
+    if (null_group_ == NONE)
+    {
+      null_group_ = add_(K(), 0, true);
+    }
+    return null_group_;
+  }
+
+  /** Returns true if group g is the null group. */
+  bool is_null(size_t g) { return nulls_.test(g); }
+
+  /** Returns the key of group g, which must not be the null group. */
+  K key(size_t g) { return Traits::get(keys_, g); }
+
+  /** Returns the aggregate states of group g. */
+  AggState *states(size_t g) { return &states_[g * num_aggs_]; }
+
+  /** Folds the groups of other into this table. Groups new to this table
+   * are added after its own, in other's order. */
+  void merge(GroupTable &other)
+  {
+    for (size_t g = 0; g < other.size(); g++)
+    {
+      size_t target = other.is_null(g) ? null_group() : find_or_add(other.key(g), other.hashes_[g]);
+      AggState *dst = states(target);
+      AggState *src = other.states(g);
+      for (size_t a = 0; a < num_aggs_; a++)
+      {
+        dst[a].merge(src[a]);
+      }
+    }
+  }
+
+private:
+  /** Appends a group with fresh states, and returns it. */
+  size_t add_(K key, uint64_t h, bool null)
+  {
+    Traits::push_back(keys_, key);
+    hashes_.push_back(h);
+    nulls_.push_back(null);
+    states_.resize(states_.size() + num_aggs_);
+    return size() - 1;
+  }
+
+  /** Doubles the slots and reinserts every group by its kept hash. */
+  void grow_()
+  {
+    std::vector<size_t> slots(slots_.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (size_t g = 0; g < size(); g++)
+    {
+      if (nulls_.test(g))
+      {
+        continue;
+      }
+      size_t i = hashes_[g] & mask;
+      while (slots[i] != 0)
+      {
+        i = (i + 1) & mask;
+      }
+      slots[i] = g + 1;
+    }
+    slots_.swap(slots);
+  }
+};
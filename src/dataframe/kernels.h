@@ -0,0 +1,290 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include "../util/bitmap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EAU2_X86 1
+#endif
+
+/** Running sum, min, max and count of present values in an int column. */
+struct IntAggregate
+{
+  long sum_ = 0;
+  int min_ = INT_MAX;
+  int max_ = INT_MIN;
+  size_t count_ = 0; // number of present values seen
+};
+
+/** Running sum, min, max and count of present values in a double column. */
+struct DoubleAggregate
+{
+  double sum_ = 0;
+  double min_ = std::numeric_limits<double>::infinity();
+  double max_ = -std::numeric_limits<double>::infinity();
+  size_t count_ = 0; // number of present values seen
+};
+
+/**
+ * Kernels::
+ * Aggregation kernels for numeric chunks.
+ *
+ * Each kernel folds one chunk (an array of values and its validity bitmap)
+ * into a running aggregate. Validity is handled 64 values at a time: runs of
+ * fully present words go through a dense SIMD kernel, words with no present
+ * value are skipped, and the rest are visited bit by bit.
+ *
+ * On x86 the dense kernels use AVX2 when the CPU supports it (checked once,
+ * at runtime, so no special compiler flags are needed) and SSE2 otherwise.
+ * Other platforms use the scalar loops.
+ */
+class Kernels
+{
+public:
+  /** Scalar fallbacks, also used for the ragged ends of the SIMD loops. */
+  static void dense_ints_scalar(const int *vals, size_t n, IntAggregate &agg)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      agg.sum_ += vals[i];
+      agg.min_ = vals[i] < agg.min_ ? vals[i] : agg.min_;
+      agg.max_ = vals[i] > agg.max_ ? vals[i] : agg.max_;
+    }
+    agg.count_ += n;
+  }
+
+  static void dense_doubles_scalar(const double *vals, size_t n, DoubleAggregate &agg)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      agg.sum_ += vals[i];
+      agg.min_ = vals[i] < agg.min_ ? vals[i] : agg.min_;
+      agg.max_ = vals[i] > agg.max_ ? vals[i] : agg.max_;
+    }
+    agg.count_ += n;
+  }
+
+#ifdef EAU2_X86
+
+  /** True if the running CPU supports AVX2. */
+  static bool has_avx2()
+  {
+    static const bool res = __builtin_cpu_supports("avx2");
+    return res;
+  }
+
+  __attribute__((target("avx2"))) static void dense_ints_avx2(const int *vals, size_t n, IntAggregate &agg)
+  {
+    __m256i sum_lo = _mm256_setzero_si256();
+    __m256i sum_hi = _mm256_setzero_si256();
+    __m256i mn = _mm256_set1_epi32(agg.min_);
+    __m256i mx = _mm256_set1_epi32(agg.max_);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(vals + i));
+      // sums are widened to 64 bits so they cannot overflow
+      sum_lo = _mm256_add_epi64(sum_lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+      sum_hi = _mm256_add_epi64(sum_hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+      mn = _mm256_min_epi32(mn, v);
+      mx = _mm256_max_epi32(mx, v);
+    }
+    long long sums[4];
+    int mins[8], maxs[8];
+    _mm256_storeu_si256((__m256i *)sums, _mm256_add_epi64(sum_lo, sum_hi));
+    _mm256_storeu_si256((__m256i *)mins, mn);
+    _mm256_storeu_si256((__m256i *)maxs, mx);
+    for (size_t j = 0; j < 4; j++)
+    {
+      agg.sum_ += sums[j];
+    }
+    for (size_t j = 0; j < 8; j++)
+    {
+      agg.min_ = mins[j] < agg.min_ ? mins[j] : agg.min_;
+      agg.max_ = maxs[j] > agg.max_ ? maxs[j] : agg.max_;
+    }
+    agg.count_ += i;
+    dense_ints_scalar(vals + i, n - i, agg);
+  }
+
+  __attribute__((target("avx2"))) static void dense_doubles_avx2(const double *vals, size_t n, DoubleAggregate &agg)
+  {
+    __m256d sum = _mm256_setzero_pd();
+    __m256d mn = _mm256_set1_pd(agg.min_);
+    __m256d mx = _mm256_set1_pd(agg.max_);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+      __m256d v = _mm256_loadu_pd(vals + i);
+      sum = _mm256_add_pd(sum, v);
+      mn = _mm256_min_pd(mn, v);
+      mx = _mm256_max_pd(mx, v);
+    }
+    double sums[4], mins[4], maxs[4];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(mins, mn);
+    _mm256_storeu_pd(maxs, mx);
+    for (size_t j = 0; j < 4; j++)
+    {
+      agg.sum_ += sums[j];
+      agg.min_ = mins[j] < agg.min_ ? mins[j] : agg.min_;
+      agg.max_ = maxs[j] > agg.max_ ? maxs[j] : agg.max_;
+    }
+    agg.count_ += i;
+    dense_doubles_scalar(vals + i, n - i, agg);
+  }
+
+  /** SSE2 has no 32-bit min/max, so they are built from a compare mask */
+  static void dense_ints_sse2(const int *vals, size_t n, IntAggregate &agg)
+  {
+    __m128i sum = _mm_setzero_si128();
+    __m128i mn = _mm_set1_epi32(agg.min_);
+    __m128i mx = _mm_set1_epi32(agg.max_);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(vals + i));
+      __m128i sign = _mm_srai_epi32(v, 31);
+      sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(v, sign));
+      sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(v, sign));
+      __m128i lt = _mm_cmplt_epi32(v, mn);
+      mn = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, mn));
+      __m128i gt = _mm_cmpgt_epi32(v, mx);
+      mx = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, mx));
+    }
+    long long sums[2];
+    int mins[4], maxs[4];
+    _mm_storeu_si128((__m128i *)sums, sum);
+    _mm_storeu_si128((__m128i *)mins, mn);
+    _mm_storeu_si128((__m128i *)maxs, mx);
+    agg.sum_ += sums[0] + sums[1];
+    for (size_t j = 0; j < 4; j++)
+    {
+      agg.min_ = mins[j] < agg.min_ ? mins[j] : agg.min_;
+      agg.max_ = maxs[j] > agg.max_ ? maxs[j] : agg.max_;
+    }
+    agg.count_ += i;
+    dense_ints_scalar(vals + i, n - i, agg);
+  }
+
+  static void dense_doubles_sse2(const double *vals, size_t n, DoubleAggregate &agg)
+  {
+    __m128d sum = _mm_setzero_pd();
+    __m128d mn = _mm_set1_pd(agg.min_);
+    __m128d mx = _mm_set1_pd(agg.max_);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128d v = _mm_loadu_pd(vals + i);
+      sum = _mm_add_pd(sum, v);
+      mn = _mm_min_pd(mn, v);
+      mx = _mm_max_pd(mx, v);
+    }
+    double sums[2], mins[2], maxs[2];
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_pd(mins, mn);
+    _mm_storeu_pd(maxs, mx);
+    for (size_t j = 0; j < 2; j++)
+    {
+      agg.sum_ += sums[j];
+      agg.min_ = mins[j] < agg.min_ ? mins[j] : agg.min_;
+      agg.max_ = maxs[j] > agg.max_ ? maxs[j] : agg.max_;
+    }
+    agg.count_ += i;
+    dense_doubles_scalar(vals + i, n - i, agg);
+  }
+
+#endif // EAU2_X86
+
+  /** Folds n values, all of them present, into agg. */
+  static void dense_ints(const int *vals, size_t n, IntAggregate &agg)
+  {
+#ifdef EAU2_X86
+    if (has_avx2())
+    {
+      dense_ints_avx2(vals, n, agg);
+    }
+    else
+    {
+      dense_ints_sse2(vals, n, agg);
+    }
+#else
+    dense_ints_scalar(vals, n, agg);
+#endif
+  }
+
+  static void dense_doubles(const double *vals, size_t n, DoubleAggregate &agg)
+  {
+#ifdef EAU2_X86
+    if (has_avx2())
+    {
+      dense_doubles_avx2(vals, n, agg);
+    }
+    else
+    {
+      dense_doubles_sse2(vals, n, agg);
+    }
+#else
+    dense_doubles_scalar(vals, n, agg);
+#endif
+  }
+
+  /**
+   * Folds the present values of a chunk into agg. Dense is the kernel used for
+   * runs of present values and scalar the one used for isolated values; T and
+   * A are the value and aggregate types.
+   */
+  template <typename T, typename A, typename Dense, typename Scalar>
+  static void masked(const T *vals, size_t n, BitmapView validity, A &agg, Dense dense, Scalar scalar)
+  {
+    if (validity.all())
+    {
+      dense(vals, n, agg);
+      return;
+    }
+    size_t run_start = 0; // start of the current run of full words
+    size_t words = (n + 63) / 64;
+    for (size_t w = 0; w < words; w++)
+    {
+      size_t base = w * 64;
+      size_t len = n - base < 64 ? n - base : 64;
+      uint64_t full = len == 64 ? ~0ULL : (1ULL << len) - 1;
+      uint64_t word = validity.word(w) & full;
+      if (word == full)
+      {
+        continue; // extends the current run
+      }
+      dense(vals + run_start, base - run_start, agg);
+      run_start = base + len;
+      while (word)
+      {
+        size_t bit = __builtin_ctzll(word);
+        scalar(vals + base + bit, 1, agg);
+        word &= word - 1;
+      }
+    }
+    dense(vals + run_start, n - run_start, agg);
+  }
+
+  /** Folds the present values of an int chunk into agg. */
+  static void aggregate(const int *vals, size_t n, BitmapView validity, IntAggregate &agg)
+  {
+    masked(vals, n, validity, agg, dense_ints, dense_ints_scalar);
+  }
+
+  /** Folds the present values of a double chunk into agg. */
+  static void aggregate(const double *vals, size_t n, BitmapView validity, DoubleAggregate &agg)
+  {
+    masked(vals, n, validity, agg, dense_doubles, dense_doubles_scalar);
+  }
+};
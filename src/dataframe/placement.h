@@ -0,0 +1,113 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "../kvstore/kv.h"
+
+/** What a placement policy knows about a chunk about to be stored. */
+struct ChunkPlacement
+{
+  ChunkId id_;           // id of the key the chunk is stored under
+  size_t chunk_idx_;     // index of the chunk in its column
+  size_t first_row_;     // row index of the chunk's first row
+  size_t bytes_;         // serialized size of the chunk
+  size_t writer_;        // node storing the chunk
+  size_t num_nodes_;     // number of nodes in the cluster
+};
+
+/**
+ * PlacementPolicy::
+ * Decides which node each chunk of a column is stored on. A column asks its
+ * policy once per chunk, when the chunk is stored; the chosen node is
+ * recorded in the chunk's key, so later reads do not depend on the policy.
+ * One policy can be shared by the columns of a dataframe (see
+ * DataFrame::set_placement), which is what lets policies co-locate or
+ * balance chunks across columns.
+ */
+class PlacementPolicy
+{
+public:
+  virtual ~PlacementPolicy() = default;
+
+  /** Returns the node, less than chunk.num_nodes_, to store chunk on. */
+  virtual size_t place(const ChunkPlacement &chunk) = 0;
+};
+
+/** Deals the chunks of each column out to the nodes in turn. The default. */
+class RoundRobinPlacement : public PlacementPolicy
+{
+public:
+  size_t place(const ChunkPlacement &chunk) { return chunk.chunk_idx_ % chunk.num_nodes_; }
+};
+
+/**
+ * Places chunks by the rows they hold: rows are dealt out to the nodes in
+ * blocks of rows_per_block_, and a chunk goes to the node of the block its
+ * first row is in. Chunks of different columns holding the same rows land
+ * on the same node even when the columns are cut into chunks differently,
+ * so a scan of a row range stays on one node for every column.
+ */
+class RowRangePlacement : public PlacementPolicy
+{
+public:
+  size_t rows_per_block_;
+
+  RowRangePlacement(size_t rows_per_block) : rows_per_block_(rows_per_block)
+  {
+    if (rows_per_block_ == 0)
+    {
+      throw std::runtime_error("rows per block must be positive!");
+    }
+  }
+
+  size_t place(const ChunkPlacement &chunk) { return chunk.first_row_ / rows_per_block_ % chunk.num_nodes_; }
+};
+
+/** Places chunks by a hash of their chunk id, spreading them without regard to
+ * column or row. */
+class HashPlacement : public PlacementPolicy
+{
+public:
+  size_t place(const ChunkPlacement &chunk) { return chunk.id_.hash() % chunk.num_nodes_; }
+};
+
+/** Keeps every chunk on the node that writes it, so building a dataframe
+ * sends nothing over the network. */
+class LocalPlacement : public PlacementPolicy
+{
+public:
+  size_t place(const ChunkPlacement &chunk) { return chunk.writer_; }
+};
+
+/**
+ * Places each chunk on the node that this policy has so far given the
+ * fewest bytes, breaking ties by the lowest node. Only the chunks placed
+ * through this policy are counted, so it balances the columns that share
+ * it. Safe to share between threads.
+ */
+class LoadAwarePlacement : public PlacementPolicy
+{
+public:
+  std::vector<size_t> bytes_; // bytes placed on each node
+  std::mutex mtx_;
+
+  size_t place(const ChunkPlacement &chunk)
+  {
+    std::lock_guard<std::mutex> lck(mtx_);
+    bytes_.resize(chunk.num_nodes_, 0);
+    size_t res = 0;
+    for (size_t i = 1; i < bytes_.size(); i++)
+    {
+      res = bytes_[i] < bytes_[res] ? i : res;
+    }
+    bytes_[res] += chunk.bytes_;
+    return res;
+  }
+};
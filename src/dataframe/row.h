@@ -6,8 +6,12 @@
 // lang::Cpp
 
 #pragma once
-#include <string>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <string>
+#include <string_view>
+#include <stdexcept>
 #include <vector>
 #include "schema.h"
 #include "fielder.h"
@@ -20,13 +24,22 @@
  * dataframe's schema. The purpose of this class is to make it easier to add
  * read/write complete rows. Internally a dataframe hold data in columns.
  * Rows have pointer equality.
+ *
+ * A row is flat: each field is a fixed-width slot stored inline in one
+ * array, and the bytes of its string fields live in a single arena owned by
+ * the row. Each string field keeps a region of the arena that it reuses
+ * while its strings fit, and only moves to a larger region (twice the size)
+ * at the end of the arena when they do not. A row that is reused for every
+ * row of a scan, as map does, therefore stops allocating once its regions
+ * are large enough for the longest strings seen.
  */
 class Row
 {
 public:
   Schema _schema;
 
-  // Attribution: https://stackoverflow.com/a/18577481/12602247 at 2/11 7:52PM
+  /** One field of the row. Strings are an offset and length into the
+   * row's arena, and keep the size of their region as capacity. */
   struct Data
   {
     enum
@@ -41,47 +54,33 @@ public:
       int ival;
       double fval;
       bool bval;
-      char *sval;
-      char *mval;
+      struct
+      {
+        uint32_t offset;
+        uint32_t length;
+      } sval;
     } val;
+    uint32_t capacity; // size of a string field's region of the arena
   };
 
-  std::vector<std::shared_ptr<Data>> _elements;
+  std::vector<Data> _elements;
+  std::string _arena; // bytes of the string fields
 
   /**
    * Constructs a row given a schema. All elements are missing at initialization.
    */
-  Row(Schema &scm)
+  Row(Schema &scm) : _schema(scm), _elements(scm.width())
   {
-    _schema = scm;
-    for (size_t i = 0; i < _schema.width(); i++)
+    for (size_t i = 0; i < _elements.size(); i++)
     {
-      auto element = std::make_shared<Data>();
-      element->type = Data::is_missing;
-      element->val.mval = new char[0];
-      _elements.push_back(element);
+      set_missing(i);
     }
   }
 
-  /**
-   * Row copy constructor. Fills in the values from the old row.
-   */
-  Row(Row &row)
-  {
-    _schema = row._schema;
-    for (size_t i = 0; i < _schema.width(); ++i)
-    {
-      auto element = std::make_shared<Data>();
-      element->type = row._elements[i]->type;
-      element->val = row._elements[i]->val;
-      _elements.push_back(element);
-    }
-  }
+  /** Row copy constructor. Fills in the values from the old row. */
+  Row(Row &row) = default;
 
-  virtual ~Row()
-  {
-    _elements.clear();
-  }
+  virtual ~Row() = default;
 
   /** Setters: set the given column with the given value. Setting a column with
     * a value of the wrong type is undefined. */
@@ -91,13 +90,12 @@ public:
     {
       if (val.is_missing())
       {
-        _elements[col]->type = Data::is_missing;
+        set_missing(col);
       }
       else
       {
-        _elements[col]->type = Data::is_int;
-        _elements[col]->val.ival = val.val();
-        ;
+        _elements[col].type = Data::is_int;
+        _elements[col].val.ival = val.val();
       }
     }
   }
@@ -107,12 +105,12 @@ public:
     {
       if (val.is_missing())
       {
-        _elements[col]->type = Data::is_missing;
+        set_missing(col);
       }
       else
       {
-        _elements[col]->type = Data::is_double;
-        _elements[col]->val.fval = val.val();
+        _elements[col].type = Data::is_double;
+        _elements[col].val.fval = val.val();
       }
     }
   }
@@ -122,12 +120,12 @@ public:
     {
       if (val.is_missing())
       {
-        _elements[col]->type = Data::is_missing;
+        set_missing(col);
       }
       else
       {
-        _elements[col]->type = Data::is_bool;
-        _elements[col]->val.bval = val.val();
+        _elements[col].type = Data::is_bool;
+        _elements[col].val.bval = val.val();
       }
     }
   }
@@ -137,81 +135,93 @@ public:
     {
       if (val.is_missing())
       {
-        _elements[col]->type = Data::is_missing;
+        set_missing(col);
       }
       else
       {
-        _elements[col]->type = Data::is_string;
-        _elements[col]->val.sval = strdup(val.val().c_str());
+        set_string(col, val.val_);
+      }
+    }
+  }
+
+  /** Sets the given string column to a copy of val, without allocating
+   * once the column's region of the arena is large enough. Val may view
+   * this row's own strings. Views returned by get_string_view are
+   * invalidated. Throws if the row's strings would outgrow the 4 GiB that
+   * its 32-bit offsets address. */
+  void set_string(size_t col, std::string_view val)
+  {
+    Data &d = _elements[col];
+    if (val.size() > d.capacity)
+    {
+      size_t capacity = std::max(val.size(), 2 * (size_t)d.capacity);
+      if (_arena.size() + capacity > UINT32_MAX)
+      {
+        throw std::runtime_error("row strings exceed 4 GiB!");
+      }
+      // growing the arena moves it, so a view into it is kept as an offset
+      const char *arena = _arena.data();
+      bool own = val.data() >= arena && val.data() < arena + _arena.size();
+      size_t val_offset = val.data() - arena;
+      d.capacity = capacity;
+      d.val.sval.offset = _arena.size();
+      _arena.resize(_arena.size() + d.capacity);
+      if (own)
+      {
+        val = std::string_view(_arena.data() + val_offset, val.size());
       }
     }
+    memmove(&_arena[d.val.sval.offset], val.data(), val.size());
+    d.val.sval.length = val.size();
+    d.type = Data::is_string;
   }
 
   /** Getters: get the value at the given column. If the column is not
-    * of the requested type, the result is undefined. */
+    * of the requested type, the result is undefined. Missing fields read
+    * as 0, false or the empty string. */
   int get_int(size_t col)
   {
-    return _elements[col]->val.ival;
+    return _elements[col].val.ival;
   }
 
   bool get_bool(size_t col)
   {
-    return _elements[col]->val.bval;
+    return _elements[col].val.bval;
   }
 
   double get_double(size_t col)
   {
-    return _elements[col]->val.fval;
+    return _elements[col].val.fval;
   }
 
   std::string get_string(size_t col)
   {
-    // there is a chance that sval is a nullptr, because it's a char* type
-    auto val = _elements[col]->val.sval;
-    if (val)
-    {
-      return val;
-    }
-    else
+    return std::string(get_string_view(col));
+  }
+
+  /** Returns a view of the string at the given column, without copying it.
+   * The view is valid until a string field of this row is next set. */
+  std::string_view get_string_view(size_t col)
+  {
+    const Data &d = _elements[col];
+    if (d.type != Data::is_string)
     {
-      return "";
+      return std::string_view();
     }
+    return std::string_view(_arena.data() + d.val.sval.offset, d.val.sval.length);
   }
 
   /** Number of fields in the row. */
   size_t width()
   {
-    size_t result = 0;
-    for (size_t i = 0; i < _elements.size(); i++)
-    {
-      if (_elements[i] != nullptr)
-      {
-        result++;
-      }
-    }
-    return result;
+    return _elements.size();
   }
 
-  /** Type of the field at the given position. An idx >= width is  undefined. */
+  /** Type of the field at the given position, as given by the schema. An
+   * idx >= width is undefined. */
   char col_type(size_t idx)
   {
-    if (idx < _elements.size())
-    {
-      switch (_elements[idx]->type)
-      {
-      case Data::is_int:
-        return 'I';
-      case Data::is_double:
-        return 'D';
-      case Data::is_bool:
-        return 'B';
-      case Data::is_string:
-        return 'S';
-      default:
-        return 'S';
-      }
-    }
-    return 'S';
+    return _schema.col_type(idx);
   }
 
   /** Given a Fielder, visit every field of this row. The first argument is
@@ -222,21 +232,21 @@ public:
     for (size_t i = 0; i < _elements.size(); i++)
     {
       f.start(i);
-      if (_elements[i]->type != Data::is_missing)
+      if (_elements[i].type != Data::is_missing)
       {
         switch (col_type(i))
         {
         case 'I':
-          f.accept(_elements[i]->val.ival);
+          f.accept(_elements[i].val.ival);
           break;
         case 'B':
-          f.accept(_elements[i]->val.bval);
+          f.accept(_elements[i].val.bval);
           break;
         case 'D':
-          f.accept(_elements[i]->val.fval);
+          f.accept(_elements[i].val.fval);
           break;
         case 'S':
-          f.accept(std::string(_elements[i]->val.sval));
+          f.accept(get_string_view(i));
           break;
         }
       }
@@ -245,23 +255,24 @@ public:
   }
 
   /**
-   * Marks the element at the specified index as missing.
-   * Adds gibberish values.
+   * Marks the element at the specified index as missing. Its value reads
+   * as zero; a string field keeps its region of the arena.
    */
-  void set_missing(int idx)
+  void set_missing(size_t idx)
   {
-    _elements[idx]->type = Data::is_missing;
-    _elements[idx]->val.bval = false;
-    _elements[idx]->val.ival = 0;
-    _elements[idx]->val.fval = 0;
-    _elements[idx]->val.sval = nullptr;
+    Data &d = _elements[idx];
+    d.type = Data::is_missing;
+    uint32_t offset = d.val.sval.offset;
+    d.val.fval = 0;
+    d.val.sval.offset = d.capacity > 0 ? offset : 0;
+    d.val.sval.length = 0;
   }
 
   /**
    * Returns true if the value at the given index is missing, false otherwise.
    */
-  bool is_missing(int idx)
+  bool is_missing(size_t idx)
   {
-    return _elements[idx]->type == Data::is_missing;
+    return _elements[idx].type == Data::is_missing;
   }
 };
@@ -7,6 +7,7 @@
 
 #pragma once
 #include <iostream>
+#include <vector>
 #include "row.h"
 #include "fielder.h"
 
@@ -43,6 +44,14 @@ public:
   {
     return nullptr;
   }
+
+  /** The columns this rower reads. Dataframes only fetch and fill these
+      columns of the rows they hand to accept; the other fields of the row
+      are left unchanged. An empty list, the default, means every column. */
+  virtual std::vector<size_t> columns()
+  {
+    return {};
+  }
 };
 
 /** Print rower for a dataframe */
@@ -85,7 +94,7 @@ public:
     {
       if (r.col_type(i) == 'S')
       {
-        if (r.get_string(i) == _search_str)
+        if (r.get_string_view(i) == _search_str)
         {
           return true;
         }
@@ -181,7 +190,7 @@ public:
     {
       if (r.col_type(i) == 'S')
       {
-        std::string str = r.get_string(i);
+        std::string_view str = r.get_string_view(i);
         for (size_t j = 0; j < str.length(); j++)
         {
           if (str[j] == _search_char)
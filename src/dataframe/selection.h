@@ -0,0 +1,81 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "../util/bitmap.h"
+
+/**
+ * Selection::
+ *
+ * The result of a filter: the ids of the rows of a dataframe that passed,
+ * in increasing order. A selection is a compact stand-in for the filtered
+ * dataframe, so operators can run over the selected rows of the original
+ * columns (see DataFrame::map) instead of copying them into a new one, and
+ * only fetch values for the rows they actually visit.
+ */
+class Selection
+{
+public:
+  std::vector<size_t> rows_; // selected row ids, increasing
+
+  Selection() = default;
+
+  /** Selects the rows whose bits are set in bits. */
+  Selection(BitmapView bits)
+  {
+    for (size_t w = 0; w < (bits.size() + 63) / 64; w++)
+    {
+      uint64_t word = bits.word(w);
+      if (w * 64 + 64 > bits.size())
+      {
+        word &= (1ULL << (bits.size() % 64)) - 1;
+      }
+      while (word)
+      {
+        rows_.push_back(w * 64 + __builtin_ctzll(word));
+        word &= word - 1;
+      }
+    }
+  }
+
+  /** Number of selected rows. */
+  size_t size() const { return rows_.size(); }
+
+  bool empty() const { return rows_.empty(); }
+
+  /** Returns the id of the idx-th selected row. */
+  size_t operator[](size_t idx) const { return rows_[idx]; }
+
+  /** Selects row, which must be greater than every row selected so far. */
+  void push_back(size_t row) { rows_.push_back(row); }
+
+  /** Returns the rows selected by both this and other. */
+  Selection intersect(const Selection &other) const
+  {
+    Selection res;
+    std::set_intersection(rows_.begin(), rows_.end(), other.rows_.begin(), other.rows_.end(),
+                          std::back_inserter(res.rows_));
+    return res;
+  }
+
+  /** Returns the selection as a bitmap over nrows rows. */
+  Bitmap to_bitmap(size_t nrows) const
+  {
+    Bitmap res(nrows, false);
+    for (size_t row : rows_)
+    {
+      res.set(row, true);
+    }
+    return res;
+  }
+
+  bool operator==(const Selection &other) const { return rows_ == other.rows_; }
+};
@@ -0,0 +1,120 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include "dataframe.h"
+
+/****************************************************************************
+ * TypedDataFrame::
+ *
+ * A view of a DataFrame whose schema is known at compile time, with one
+ * type in Ts per column (int, bool, double or std::string). Rows are
+ * std::tuples, and every column is read through its TypedColumn, so loops
+ * over a typed frame are compiled for its exact schema: there is no switch
+ * on the column types, no Row and no Fielder.
+ *
+ * The data lives in an ordinary DataFrame, which can be serialized and put
+ * in the KVStore as usual; a typed frame can wrap any DataFrame with a
+ * matching schema, and frames built through it can be read untyped.
+ *
+ * Typed frames have no notion of missing values. Missing fields read as
+ * whatever their column holds at that row.
+ */
+template <typename... Ts>
+class TypedDataFrame
+{
+public:
+  /** A row as read: strings are views, valid during the callback. */
+  using Tuple = std::tuple<typename ColumnTraits<Ts>::Value...>;
+
+  std::shared_ptr<DataFrame> df_;
+
+  /** Creates an empty frame. */
+  TypedDataFrame()
+  {
+    const char types[] = {ColumnTraits<Ts>::TYPE..., '\0'};
+    Schema schema(types);
+    df_ = std::make_shared<DataFrame>(schema);
+  }
+
+  /** Wraps df, which must have exactly the columns Ts, or this throws. */
+  TypedDataFrame(std::shared_ptr<DataFrame> df) : df_(df)
+  {
+    const char types[] = {ColumnTraits<Ts>::TYPE..., '\0'};
+    bool matches = df_->ncols() == sizeof...(Ts);
+    for (size_t i = 0; matches && i < sizeof...(Ts); i++)
+    {
+      matches = df_->get_schema().col_type(i) == types[i];
+    }
+    if (!matches)
+    {
+      throw std::runtime_error("dataframe does not match the typed schema!");
+    }
+  }
+
+  /** The number of rows. */
+  size_t nrows() { return df_->nrows(); }
+
+  /** Returns the column at index I under its static type. */
+  template <size_t I>
+  auto column()
+  {
+    using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+    return static_cast<TypedColumn<T> *>(df_->cols_[I].get());
+  }
+
+  /** Adds a row at the end of the frame. */
+  void add_row(Ts... vals, std::shared_ptr<KVStore> store)
+  {
+    add_row_(std::index_sequence_for<Ts...>(), store, vals...);
+  }
+
+  /** Returns the value at the given column and row. Strings are copied. */
+  template <size_t I>
+  auto get(size_t row, std::shared_ptr<KVStore> store)
+  {
+    return column<I>()->get(row, store);
+  }
+
+  /**
+   * Calls fn(row) for every row, in order, where row is a Tuple. Only the
+   * chunk under each column's cursor is pinned, so views into strings are
+   * only valid during the call.
+   */
+  template <typename F>
+  void for_each(F fn, std::shared_ptr<KVStore> store)
+  {
+    for_each_(std::index_sequence_for<Ts...>(), fn, store);
+  }
+
+  /** Serializes the underlying dataframe; it reads back as either kind. */
+  void serialize(Serializer &ser) { df_->serialize(ser); }
+
+  static TypedDataFrame deserialize(Deserializer &dser) { return TypedDataFrame(DataFrame::deserialize(dser)); }
+
+private:
+  template <size_t... Is>
+  void add_row_(std::index_sequence<Is...>, std::shared_ptr<KVStore> store, Ts... vals)
+  {
+    df_->get_schema().add_row();
+    (column<Is>()->push_back(vals, store), ...);
+  }
+
+  template <size_t... Is, typename F>
+  void for_each_(std::index_sequence<Is...>, F &fn, std::shared_ptr<KVStore> store)
+  {
+    ColumnCursor cursors[] = {ColumnCursor(df_->cols_[Is].get(), store)...};
+    for (size_t i = 0; i < nrows(); i++)
+    {
+      fn(Tuple(cursors[Is].template get<Ts>(i)...));
+    }
+  }
+};
@@ -0,0 +1,135 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "../util/serial.h"
+
+/**
+ * DistinctSketch::
+ *
+ * A small HyperLogLog sketch estimating the number of distinct values added
+ * to it, within about 13% using 64 one-byte registers. Sketches of
+ * different chunks merge by taking the larger of each register, so the
+ * distinct count of a whole column can be estimated from its chunks' zone
+ * maps without reading any values.
+ */
+class DistinctSketch
+{
+public:
+  static const size_t REGISTERS = 64;
+  uint8_t registers_[REGISTERS] = {};
+
+  /** Mixes the bits of v, so that nearby values land far apart. */
+  static uint64_t hash(uint64_t v)
+  {
+    v += 0x9e3779b97f4a7c15ULL;
+    v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+    return v ^ (v >> 31);
+  }
+
+  /** Adds a value, given as a 64-bit hash of it. */
+  void add_hash(uint64_t h)
+  {
+    uint64_t rest = h >> 6;
+    uint8_t rank = rest == 0 ? 59 : __builtin_ctzll(rest) + 1;
+    uint8_t &reg = registers_[h % REGISTERS];
+    reg = rank > reg ? rank : reg;
+  }
+
+  /** Folds another sketch into this one. */
+  void merge(const DistinctSketch &other)
+  {
+    for (size_t i = 0; i < REGISTERS; i++)
+    {
+      registers_[i] = other.registers_[i] > registers_[i] ? other.registers_[i] : registers_[i];
+    }
+  }
+
+  /** Returns the estimated number of distinct values added. */
+  size_t estimate() const
+  {
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < REGISTERS; i++)
+    {
+      sum += std::ldexp(1.0, -registers_[i]);
+      zeros += registers_[i] == 0;
+    }
+    double m = REGISTERS;
+    double res = 0.709 * m * m / sum;
+    if (res <= 2.5 * m && zeros > 0)
+    {
+      res = m * std::log(m / zeros); // linear counting for small counts
+    }
+    return (size_t)std::llround(res);
+  }
+
+  void serialize(Serializer &ser) { ser.write_bytes(registers_, REGISTERS); }
+
+  static DistinctSketch deserialize(Deserializer &dser)
+  {
+    DistinctSketch res;
+    dser.read_bytes(res.registers_, REGISTERS);
+    return res;
+  }
+};
+
+/**
+ * ChunkStats::
+ *
+ * The zone map of one stored chunk: the smallest and largest present value
+ * (for ordered types), the number of missing values, and a sketch of the
+ * number of distinct values. Columns record one per chunk when the chunk is
+ * stored, next to its key, so that scans with a predicate can skip chunks
+ * that cannot match without fetching them.
+ *
+ * Ints and bools are kept as doubles, which represent them exactly.
+ */
+class ChunkStats
+{
+public:
+  bool has_range_ = false; // false if no value is present, or for strings
+  double min_ = 0;
+  double max_ = 0;
+  size_t null_count_ = 0;
+  DistinctSketch distinct_;
+
+  /** Widens the range to include v. */
+  void add_to_range(double v)
+  {
+    min_ = !has_range_ || v < min_ ? v : min_;
+    max_ = !has_range_ || v > max_ ? v : max_;
+    has_range_ = true;
+  }
+
+  /** Returns false if no present value of the chunk can be in [lo, hi]. */
+  bool overlaps(double lo, double hi) const { return has_range_ && min_ <= hi && max_ >= lo; }
+
+  void serialize(Serializer &ser)
+  {
+    ser.write_bool(has_range_);
+    ser.write_double(min_);
+    ser.write_double(max_);
+    ser.write_size_t(null_count_);
+    distinct_.serialize(ser);
+  }
+
+  static ChunkStats deserialize(Deserializer &dser)
+  {
+    ChunkStats res;
+    res.has_range_ = dser.read_bool();
+    res.min_ = dser.read_double();
+    res.max_ = dser.read_double();
+    res.null_count_ = dser.read_size_t();
+    res.distinct_ = DistinctSketch::deserialize(dser);
+    return res;
+  }
+};
@@ -0,0 +1,148 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <list>
+#include <map>
+#include <memory>
+#include "../network/thread.h"
+#include "kv.h"
+
+class ColumnChunkView;
+
+/**
+ * ChunkCache::
+ *
+ * A node-wide cache of decoded column chunks, keyed by the chunk's Key.
+ * Every column read on a node goes through the cache owned by the node's
+ * KVStore, so alternating between chunks (or between columns of the same
+ * rows) no longer refetches them.
+ *
+ * The cache holds at most budget_ bytes and evicts the least recently used
+ * chunk when it runs over. The most recently inserted chunk is always kept,
+ * even if it alone is over budget. Hit, miss and eviction counts are kept
+ * for tuning the budget.
+ *
+ * This cache utilizes a lock to make it thread-safe.
+ */
+class ChunkCache
+{
+public:
+  /** A cached chunk and the number of bytes it is charged for. */
+  struct Entry
+  {
+    Key key_;
+    std::shared_ptr<ColumnChunkView> chunk_;
+    size_t bytes_;
+  };
+
+  static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+  std::list<Entry> lru_; // most recently used at the front
+  std::map<Key, std::list<Entry>::iterator, KeyCompare> index_;
+  size_t budget_;    // maximum number of bytes held
+  size_t bytes_ = 0; // number of bytes currently held
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  size_t evictions_ = 0;
+  Lock lock_;
+
+  ChunkCache(size_t budget = DEFAULT_BUDGET) : budget_(budget) {}
+
+  ~ChunkCache() = default;
+
+  /**
+   * Returns the chunk cached under k and marks it as most recently used,
+   * or nullptr (counted as a miss) if it is not cached.
+   */
+  std::shared_ptr<ColumnChunkView> get(const Key &k)
+  {
+    lock_.lock();
+    auto search = index_.find(k);
+    if (search == index_.end())
+    {
+      misses_++;
+      lock_.unlock();
+      return nullptr;
+    }
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, search->second);
+    auto res = search->second->chunk_;
+    lock_.unlock();
+    return res;
+  }
+
+  /**
+   * Caches chunk under k, charging it the given number of bytes, and evicts
+   * least recently used chunks until the cache is within budget.
+   */
+  void put(const Key &k, std::shared_ptr<ColumnChunkView> chunk, size_t bytes)
+  {
+    lock_.lock();
+    erase_(k);
+    lru_.push_front(Entry{k, chunk, bytes});
+    index_.insert_or_assign(k, lru_.begin());
+    bytes_ += bytes;
+    while (bytes_ > budget_ && lru_.size() > 1)
+    {
+      erase_(lru_.back().key_);
+      evictions_++;
+    }
+    lock_.unlock();
+  }
+
+  /** Returns true if a chunk is cached under k, without using it or
+   * counting a hit or a miss. */
+  bool contains(const Key &k)
+  {
+    lock_.lock();
+    bool res = index_.count(k) > 0;
+    lock_.unlock();
+    return res;
+  }
+
+  /** Drops the chunk cached under k, if any. */
+  void erase(const Key &k)
+  {
+    lock_.lock();
+    erase_(k);
+    lock_.unlock();
+  }
+
+  /** Changes the byte budget, evicting chunks if the cache is now over it. */
+  void set_budget(size_t budget)
+  {
+    lock_.lock();
+    budget_ = budget;
+    while (bytes_ > budget_ && lru_.size() > 0)
+    {
+      erase_(lru_.back().key_);
+      evictions_++;
+    }
+    lock_.unlock();
+  }
+
+  /** Counters and sizes, for reporting. */
+  size_t hits() { return hits_; }
+  size_t misses() { return misses_; }
+  size_t evictions() { return evictions_; }
+  size_t bytes() { return bytes_; }
+  size_t size() { return lru_.size(); }
+
+private:
+  /** Removes k from the cache. The lock must be held. */
+  void erase_(const Key &k)
+  {
+    auto search = index_.find(k);
+    if (search != index_.end())
+    {
+      bytes_ -= search->second->bytes_;
+      lru_.erase(search->second);
+      index_.erase(search);
+    }
+  }
+};
@@ -0,0 +1,57 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <atomic>
+#include <stdexcept>
+
+/**
+ * ChunkSizing::
+ * The target size in bytes of the chunks of each column type, kept by each
+ * node's KVStore. A column stores its cache as a chunk once the cache
+ * reaches its type's target or MAX_CHUNK_SIZE rows, whichever comes first,
+ * so chunks of wide values (long strings, say) stay a predictable size, and
+ * the size can be tuned for cache residency or the network.
+ *
+ * The defaults are large enough that ints, doubles and bools are cut at
+ * MAX_CHUNK_SIZE rows, keeping the chunks of those columns aligned across
+ * a dataframe; only string columns are cut by size. Targets should be set
+ * before columns are built; columns with different targets simply have
+ * chunk boundaries at different rows. Targets are atomic, so setting one
+ * while another thread appends is safe, though the chunk being filled may
+ * be cut at either target.
+ */
+class ChunkSizing
+{
+public:
+  static const size_t DEFAULT_TARGET = 256 * 1024;
+
+  std::atomic<size_t> targets_[4] = {{DEFAULT_TARGET}, {DEFAULT_TARGET}, {DEFAULT_TARGET}, {DEFAULT_TARGET}};
+
+  /** Returns the byte target of columns of type 'I', 'B', 'D' or 'S'. */
+  size_t target(char type) { return targets_[index_(type)].load(std::memory_order_relaxed); }
+
+  void set_target(char type, size_t bytes) { targets_[index_(type)].store(bytes, std::memory_order_relaxed); }
+
+private:
+  static size_t index_(char type)
+  {
+    switch (type)
+    {
+    case 'I':
+      return 0;
+    case 'B':
+      return 1;
+    case 'D':
+      return 2;
+    case 'S':
+      return 3;
+    default:
+      throw std::runtime_error("bad column type!");
+    }
+  }
+};
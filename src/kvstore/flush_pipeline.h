@@ -0,0 +1,203 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+#include "../network/thread.h"
+
+/**
+ * FlushPipeline::
+ *
+ * Stores the chunks filled by a node's columns in the background. When a
+ * column's cache fills, the column records the chunk's key and hands the
+ * chunk over as a job, which serializes the chunk and puts it in the store.
+ * The column then keeps appending while a single worker thread runs the
+ * jobs in order. At most max_in_flight_ jobs are queued or running at once,
+ * and submitting another blocks until one finishes, which bounds the memory
+ * held by chunks waiting to be encoded and sent.
+ *
+ * Each KVStore's pipeline allows DEFAULT_IN_FLIGHT jobs. A get of a chunk
+ * that has not been put yet waits for it (locally, see
+ * KVStore::mark_pending) or retries (remotely), so readers need not know
+ * about the pipeline. A max_in_flight_ of 0, the default of a pipeline made
+ * on its own, runs each job on the thread that submits it, so a chunk is in
+ * the store as soon as it is cut (see set_max_in_flight). drain() waits for
+ * every job to finish and rethrows the first error a job threw; later
+ * submits rethrow it too.
+ *
+ * The worker is started by the first job, and joined when the pipeline is
+ * destroyed, after the remaining jobs have run. A job may hold the last
+ * reference to the pipeline's owner, in which case the worker destroys the
+ * pipeline itself and is detached rather than joined (see run_).
+ *
+ * This pipeline utilizes a lock to make it thread-safe.
+ */
+class FlushPipeline
+{
+public:
+  static const size_t DEFAULT_IN_FLIGHT = 8;
+
+  std::deque<std::function<void()>> jobs_; // submitted jobs not yet started, oldest first
+  size_t max_in_flight_;                   // most jobs queued or running at once, 0 if synchronous
+  size_t in_flight_ = 0;                   // jobs queued or running
+  size_t completed_ = 0;                   // jobs run by the worker
+  bool stopping_ = false;                  // set when the pipeline is destroyed
+  bool *destroyed_ = nullptr;              // set if the worker destroys the pipeline, see run_
+  std::exception_ptr error_;               // first error thrown by a job, not yet rethrown
+  std::thread worker_;
+  Lock lock_;
+
+  FlushPipeline(size_t max_in_flight = 0) : max_in_flight_(max_in_flight) {}
+
+  ~FlushPipeline()
+  {
+    if (worker_.joinable() && worker_.get_id() == std::this_thread::get_id())
+    {
+      // destroyed by a finished job's captures: run what is left here
+      for (std::function<void()> &job : jobs_)
+      {
+        try
+        {
+          job();
+        }
+        catch (...)
+        {
+        }
+      }
+      *destroyed_ = true;
+      worker_.detach();
+      return;
+    }
+    lock_.lock();
+    stopping_ = true;
+    lock_.unlock();
+    lock_.notify_all();
+    if (worker_.joinable())
+    {
+      worker_.join();
+    }
+  }
+
+  /** Returns true if jobs are run by the worker rather than inline. */
+  bool async() { return max_in_flight_ > 0; }
+
+  /** Waits for the jobs in flight, then bounds them at max_in_flight from
+   * now on. 0 makes the pipeline synchronous. */
+  void set_max_in_flight(size_t max_in_flight)
+  {
+    drain();
+    lock_.lock();
+    max_in_flight_ = max_in_flight;
+    lock_.unlock();
+  }
+
+  /** Runs job in the background, blocking first while the pipeline is
+   * full. Rethrows an earlier job's error instead of running job. */
+  void submit(std::function<void()> job)
+  {
+    if (!async())
+    {
+      job();
+      return;
+    }
+    lock_.lock();
+    while (in_flight_ >= max_in_flight_ && !error_)
+    {
+      lock_.wait();
+    }
+    rethrow_error_();
+    if (!worker_.joinable())
+    {
+      worker_ = std::thread([this] { run_(); });
+    }
+    jobs_.push_back(std::move(job));
+    in_flight_++;
+    lock_.unlock();
+    lock_.notify_all();
+  }
+
+  /** Blocks until every submitted job has finished, and rethrows the first
+   * error one of them threw. */
+  void drain()
+  {
+    lock_.lock();
+    while (in_flight_ > 0)
+    {
+      lock_.wait();
+    }
+    rethrow_error_();
+    lock_.unlock();
+  }
+
+private:
+  /** Must hold the lock; releases it before rethrowing. */
+  void rethrow_error_()
+  {
+    if (error_)
+    {
+      std::exception_ptr err = error_;
+      error_ = nullptr;
+      lock_.unlock();
+      std::rethrow_exception(err);
+    }
+  }
+
+  /** The worker: runs jobs until the pipeline is destroyed and empty. A
+   * job is destroyed last, after its completion is counted, since releasing
+   * its captures may destroy the pipeline; the worker then returns without
+   * touching it again. */
+  void run_()
+  {
+    bool destroyed = false;
+    destroyed_ = &destroyed;
+    while (true)
+    {
+      lock_.lock();
+      while (jobs_.empty() && !stopping_)
+      {
+        lock_.wait();
+      }
+      if (jobs_.empty())
+      {
+        lock_.unlock();
+        return;
+      }
+      std::function<void()> job = std::move(jobs_.front());
+      jobs_.pop_front();
+      lock_.unlock();
+
+      std::exception_ptr err;
+      try
+      {
+        job();
+      }
+      catch (...)
+      {
+        err = std::current_exception();
+      }
+
+      lock_.lock();
+      if (err && !error_)
+      {
+        error_ = err;
+      }
+      in_flight_--;
+      completed_++;
+      lock_.unlock();
+      lock_.notify_all();
+
+      job = nullptr;
+      if (destroyed)
+      {
+        return;
+      }
+    }
+  }
+};
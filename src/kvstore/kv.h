@@ -6,33 +6,101 @@
 // lang::Cpp
 
 #pragma once
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include "../util/serial.h"
 
+/**
+ * ChunkId::
+ * Compact binary name of a column chunk: the node that created it in the
+ * high 16 bits and a counter local to that node in the low 48 bits, so ids
+ * are unique across the cluster without any coordination. Counters start at
+ * 1, so no chunk id is 0, which keys use to mean "named".
+ */
+class ChunkId
+{
+public:
+  static const size_t COUNTER_BITS = 48;
+
+  uint64_t id_ = 0;
+
+  ChunkId() = default;
+  explicit ChunkId(uint64_t id) : id_(id) {}
+  /** Throws if node does not fit in 16 bits or counter in 48, since either
+   * would spill into the other and collide with another node's ids. */
+  ChunkId(size_t node, uint64_t counter) : id_(((uint64_t)node << COUNTER_BITS) | counter)
+  {
+    if (node >= (1ULL << (64 - COUNTER_BITS)) || counter >= (1ULL << COUNTER_BITS))
+    {
+      throw std::runtime_error("chunk id out of range!");
+    }
+  }
+
+  /** The node that created the chunk. */
+  size_t node() const { return id_ >> COUNTER_BITS; }
+
+  /** The creating node's count of chunks, at this one. */
+  uint64_t counter() const { return id_ & ((1ULL << COUNTER_BITS) - 1); }
+
+  /** A well-mixed hash of the id (the splitmix64 finalizer), since
+   * consecutive ids differ only in their low bits. */
+  uint64_t hash() const
+  {
+    uint64_t h = id_;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+  }
+
+  bool operator==(const ChunkId &other) const { return id_ == other.id_; }
+  bool operator<(const ChunkId &other) const { return id_ < other.id_; }
+};
+
 /** 
- * Key of a key-value store which consists of a unique string name and
- * the home node that it exists on 
+ * Key of a key-value store which consists of a unique name and the home
+ * node that it exists on. Keys picked by users are named by strings (such
+ * as "main"); the keys of column chunks are named by a ChunkId instead,
+ * which is cheaper to compare, hash, store and send. A key has either a
+ * non-zero id_ or a name_, never both.
  * */
 class Key
 {
 public:
-  std::string name_; // name to refer to key
+  std::string name_; // name to refer to key, empty for chunk keys
+  ChunkId id_;       // id of the chunk, 0 for named keys
   size_t home_;      // index of home node
   Key(std::string name, size_t home) : name_(name), home_(home) {}
-  Key(const Key &other)
+  Key(ChunkId id, size_t home) : id_(id), home_(home) {}
+  Key(const Key &other) = default;
+  ~Key() = default;
+
+  /** Returns true if this key names a chunk rather than a user value. */
+  bool is_chunk() const { return id_.id_ != 0; }
+
+  /** Returns the key's name, or a readable form of its chunk id. */
+  std::string to_string() const
   {
-    name_ = other.name_;
-    home_ = other.home_;
+    if (!is_chunk())
+    {
+      return name_;
+    }
+    return "chunk-" + std::to_string(id_.node()) + "-" + std::to_string(id_.counter());
   }
-  ~Key() = default;
 
   /**
-   * Serializes this key with its name first, and then its home node.
+   * Serializes this key with its chunk id first, then its name if it is a
+   * named key, and then its home node.
    */
   void serialize(Serializer &ser)
   {
-    ser.write_string(name_);
+    ser.write_size_t(id_.id_);
+    if (!is_chunk())
+    {
+      ser.write_string(name_);
+    }
     ser.write_size_t(home_);
   }
 
@@ -41,6 +109,12 @@ public:
    */
   static std::shared_ptr<Key> deserialize(Deserializer &dser)
   {
+    ChunkId id(dser.read_size_t());
+    if (id.id_ != 0)
+    {
+      size_t home = dser.read_size_t();
+      return std::make_shared<Key>(id, home);
+    }
     std::string name = dser.read_string();
     size_t home = dser.read_size_t();
     return std::make_shared<Key>(name, home);
@@ -48,43 +122,59 @@ public:
 };
 
 /** 
- * Stores the binary representation of an object in the kv-store
+ * Used for comparing keys in a std::map. Needed to maintain order and
+ * for comparing and retrieving keys. Chunk keys are ordered by their ids,
+ * an integer comparison; named keys (id 0) sort first, by name.
+ */
+struct KeyCompare
+{
+  bool operator()(const Key &lhs, const Key &rhs) const
+  {
+    if (!(lhs.id_ == rhs.id_))
+    {
+      return lhs.id_ < rhs.id_;
+    }
+    return lhs.name_ < rhs.name_;
+  }
+};
+
+/** 
+ * Stores the binary representation of an object in the kv-store.
+ *
+ * The bytes are immutable once the value is constructed, so copies of a
+ * value share one buffer instead of duplicating it. The buffer is freed
+ * when the last copy goes away. Because the buffer comes from new[], it is
+ * aligned for any fixed-width type, which lets chunk views read arrays
+ * straight out of it.
  */
 class Value
 {
 public:
-  char *data_;    // serialized data
-  size_t length_; // length of serialized data
+  std::shared_ptr<char> data_; // serialized data, shared between copies
+  size_t length_;              // length of serialized data
 
   Value()
   {
-    data_ = nullptr;
     length_ = 0;
   }
 
   Value(char *data, size_t length) : length_(length)
   {
-    data_ = new char[length];
-    memcpy(data_, data, length);
+    data_ = std::shared_ptr<char>(new char[length], std::default_delete<char[]>());
+    if (length > 0)
+    {
+      memcpy(data_.get(), data, length);
+    }
   }
 
-  Value(const Value &other)
-  {
-    length_ = other.length_;
-    data_ = new char[length_];
-    memcpy(data_, other.data_, length_);
-  }
+  Value(const Value &other) = default;
 
-  /**
-   * TODO: Properly manage the memory stored by the data_ object
-   */
-  ~Value()
-  {
-    //delete[] data_;
-  }
+  Value &operator=(const Value &other) = default;
+
+  ~Value() = default;
 
   /** Gets a pointer to the data stored. */
-  char *data() { return data_; }
+  char *data() { return data_.get(); }
 
   /** Length of the data stored. */
   size_t length() { return length_; }
@@ -95,7 +185,7 @@ public:
   void serialize(Serializer &ser)
   {
     ser.write_size_t(length_);
-    ser.write_chars(data_, length_);
+    ser.write_chars(data(), length_);
   }
 
   /**
@@ -105,6 +195,8 @@ public:
   {
     size_t len = dser.read_size_t();
     char *data = dser.read_chars(len);
-    return std::make_shared<Value>(data, len);
+    auto res = std::make_shared<Value>(data, len);
+    delete[] data;
+    return res;
   }
 };
\ No newline at end of file
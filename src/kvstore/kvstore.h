@@ -6,23 +6,16 @@
 // lang::Cpp
 
 #pragma once
+#include <chrono>
 #include <map>
+#include <set>
 #include "../network/net_ifc.h"
+#include "chunk_cache.h"
+#include "chunk_sizing.h"
+#include "flush_pipeline.h"
+#include "prefetcher.h"
 #include "../util/serial.h"
 
-/** 
- * Used for comparing keys in a std::map. Needed to maintain order and
- * for comparing and retrieving keys. Uses the name_ of the key because
- * the name_ is a unique field of each key.
- */
-struct KeyCompare
-{
-  bool operator()(const Key &lhs, const Key &rhs) const
-  {
-    return lhs.name_ < rhs.name_;
-  }
-};
-
 /** 
  * Key Value Store - users can associate keys with values and retrieve them.
  * 
@@ -33,6 +26,11 @@ struct KeyCompare
  * The KVStore is also responsible for registering with the network upon
  * instantiation, so other nodes can query it.
  * 
+ * Each store also owns the node's ChunkCache, which every column read on
+ * this node goes through, its Prefetcher, which fetches chunks ahead of
+ * scans, and its FlushPipeline, which every chunk written on this node goes
+ * through.
+ *
  * This store utilizes a lock to make it thread-safe.
  */
 class KVStore
@@ -43,8 +41,20 @@ public:
   std::shared_ptr<NetworkIfc> net_;
   Lock lock_;
   size_t num_nodes_ = 1;
-  std::vector<std::shared_ptr<Value>> replies_;
+  std::map<size_t, std::shared_ptr<Value>> replies_; // replies by request id
+  std::set<size_t> abandoned_;                       // ids of Gets no longer waited for
+  size_t next_msg_id_ = 0;                           // id of the next Get sent
+  size_t next_map_id_ = 0;                           // id of the next distributed map
+  uint64_t next_chunk_ = 1;                          // counter of the next chunk id
+  std::set<Key, KeyCompare> pending_;                // local keys that flusher_ is yet to put
+  size_t max_local_wait_ms_ = 60 * 1000;             // longest wait for a local chunk not pending
   size_t MAX_REPLY_SIZE = 1000;
+  ChunkCache chunk_cache_;   // decoded chunks read on this node
+  Prefetcher prefetcher_;    // chunks being fetched ahead of scans
+  ChunkSizing chunk_sizing_; // byte targets of the chunks of columns built on this node
+  // chunks being stored in the background; declared last so that it is
+  // destroyed, finishing its jobs, before the rest of the store
+  FlushPipeline flusher_{FlushPipeline::DEFAULT_IN_FLIGHT};
 
   KVStore() = default;
   KVStore(size_t idx, std::shared_ptr<NetworkIfc> net, size_t num_nodes) : idx_(idx), net_(net), num_nodes_(num_nodes) {}
@@ -54,24 +64,62 @@ public:
 
   void set_num_nodes(size_t num_nodes) { num_nodes_ = num_nodes; }
 
+  /** Returns a chunk id not yet used by any node of the cluster. */
+  ChunkId new_chunk_id()
+  {
+    lock_.lock();
+    ChunkId res(idx_, next_chunk_++);
+    lock_.unlock();
+    return res;
+  }
+
+  /** Files a reply under the id of the Get it answers. */
   void handle_reply(Reply &reply)
   {
     lock_.lock();
-    auto value = std::make_shared<Value>(reply.data_, reply.len_);
-    replies_.push_back(value);
+    if (abandoned_.erase(reply.id_))
+    {
+      lock_.unlock();
+      return;
+    }
+    replies_.insert_or_assign(reply.id_, std::make_shared<Value>(reply.v_));
     lock_.unlock();
     lock_.notify_all();
   }
 
-  std::shared_ptr<Value> wait_and_pop()
+  /**
+   * Blocks until the reply to the Get with the given id arrives, and returns
+   * it. Replies are matched by id so that several threads can wait on
+   * remote gets at the same time. With a timeout_ms other than 0, gives up
+   * after that long and returns nullptr; the reply is dropped when it
+   * arrives.
+   */
+  std::shared_ptr<Value> wait_and_pop(size_t id, size_t timeout_ms = 0)
   {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
     lock_.lock();
-    while (replies_.size() == 0)
+    auto search = replies_.find(id);
+    while (search == replies_.end())
     {
-      lock_.wait();
+      if (timeout_ms == 0)
+      {
+        lock_.wait();
+      }
+      else
+      {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+          abandoned_.insert(id);
+          lock_.unlock();
+          return nullptr;
+        }
+        lock_.wait_for(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+      }
+      search = replies_.find(id);
     }
-    auto result = replies_.back();
-    replies_.pop_back();
+    auto result = search->second;
+    replies_.erase(search);
     lock_.unlock();
     lock_.notify_all();
     return result;
@@ -102,32 +150,108 @@ public:
     throw std::runtime_error("Cannot find key!");
   }
 
-  Value &wait_and_get_help(Key &k)
+  /** Asks the home node of k for its value once. Returns false, leaving
+   * res alone, if that node does not have k yet, or if a timeout_ms other
+   * than 0 passes without a reply (see wait_and_pop). */
+  bool try_get_remote(Key &k, Value &res, size_t timeout_ms = 0)
+  {
+    lock_.lock();
+    size_t id = next_msg_id_++;
+    lock_.unlock();
+    auto get_msg = std::make_shared<Get>(MsgKind::Get, idx_, k.home_, id, k);
+    net_->send_msg(get_msg);
+    auto val = wait_and_pop(id, timeout_ms);
+    if (!val || val->length() == 0)
+    {
+      return false;
+    }
+    res = *val;
+    return true;
+  }
+
+  Value wait_and_get_help(Key &k)
   {
     // ask cluster
-    while (true)
+    Value res;
+    while (!try_get_remote(k, res))
     {
-      auto get_msg = std::make_shared<Get>(MsgKind::Get, idx_, k.home_, 0, k);
-      net_->send_msg(get_msg);
-      auto val = wait_and_pop();
-      if (val->length() != 0)
+      Thread::sleep(1);
+    }
+    return res;
+  }
+
+  /**
+   * Blocks until k has been put on this node, and returns its value. Named
+   * keys, which other nodes may put at any point of an application (results
+   * of a distributed map, say), are waited for as long as that takes, and
+   * so are chunk keys that flusher_ is still to put. Any other chunk key is
+   * waited for at most max_local_wait_ms_, since a chunk that its writer
+   * has not stored by then most likely never will be: a chunk that is
+   * never stored is then an error rather than a hang.
+   */
+  Value wait_and_get_local_(Key &k)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(max_local_wait_ms_);
+    lock_.lock();
+    auto search = store_.find(k);
+    while (search == store_.end())
+    {
+      if (!k.is_chunk() || pending_.count(k))
       {
-        return *val;
+        lock_.wait();
       }
-      Thread::sleep(1);
+      else
+      {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+          lock_.unlock();
+          throw std::runtime_error("Cannot find key!");
+        }
+        lock_.wait_for(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+      }
+      search = store_.find(k);
     }
+    Value res = search->second;
+    lock_.unlock();
+    return res;
+  }
+
+  /** Records that flusher_ will put k, so that local reads of k wait for
+   * it however long the pipeline takes. Keys of other nodes are ignored. */
+  void mark_pending(const Key &k)
+  {
+    if (k.home_ != idx_)
+    {
+      return;
+    }
+    lock_.lock();
+    pending_.insert(k);
+    lock_.unlock();
+  }
+
+  /** Forgets that k is pending, for a job that failed before putting it.
+   * Readers waiting on chunk k go back to a bounded wait. */
+  void unmark_pending(const Key &k)
+  {
+    lock_.lock();
+    pending_.erase(k);
+    lock_.unlock();
+    lock_.notify_all();
   }
 
   /** 
-   * This calls the non-blocking value if the key exists on this node. Otherwise,
-   * it queries another node for the value, and blocks until it returns. 
+   * Returns the value of the given key, blocking until it exists. Keys that
+   * live on this node are waited for locally, and throw if they are chunks
+   * that do not turn up (see wait_and_get_local_); otherwise another node
+   * is queried for the value until it has one.
    */
-  Value &waitAndGet(Key k)
+  Value waitAndGet(Key k)
   {
     size_t target_idx = k.home_;
     if (target_idx == idx_)
     {
-      return get(k);
+      return wait_and_get_local_(k);
     }
     else
     {
@@ -147,9 +271,14 @@ public:
     size_t target_idx = k.home_;
     if (target_idx == idx_)
     {
+      // drop any decoded copy first: a reader woken by the insert may
+      // cache the new value before this thread gets further
+      chunk_cache_.erase(k);
       lock_.lock();
       store_.insert_or_assign(k, v);
+      pending_.erase(k);
       lock_.unlock();
+      lock_.notify_all();
     }
     else
     {
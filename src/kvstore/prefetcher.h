@@ -0,0 +1,182 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+#include "../network/thread.h"
+#include "kv.h"
+
+/**
+ * Prefetcher::
+ *
+ * Fetches chunks that a scan is about to read, in the background, so that
+ * waiting on the network overlaps with the scan's work on the chunks it
+ * already has. Scans that find themselves reading the chunks of a column in
+ * order ask for the next readahead_ chunks (see Column::prefetch_); each
+ * request is a job, run by one of a few worker threads, that gets the chunk
+ * and puts it in the node's ChunkCache.
+ *
+ * A key is only fetched once at a time. A reader that needs a chunk still
+ * being prefetched waits for that fetch rather than sending its own (see
+ * wait), and one still queued is handed back to the reader to fetch itself.
+ * Prefetching is best effort: a job that throws is forgotten, and the
+ * reader fetches the chunk as usual.
+ *
+ * Workers are started by the first job. When the prefetcher is destroyed,
+ * queued jobs are dropped and running ones are waited for. A job waits at
+ * most REPLY_WAIT_MS for each reply and checks stopping() between tries,
+ * so a chunk that its home node does not have yet, or a node that does not
+ * answer, holds the destructor up for no longer than that.
+ *
+ * This prefetcher utilizes a lock to make it thread-safe.
+ */
+class Prefetcher
+{
+public:
+  static const size_t DEFAULT_READAHEAD = 2;
+  static const size_t NUM_WORKERS = 2;
+  static const size_t REPLY_WAIT_MS = 100;
+
+  std::deque<Key> queue_;                                   // keys waiting for a worker, oldest first
+  std::map<Key, std::function<void()>, KeyCompare> queued_; // jobs of the keys in queue_
+  std::set<Key, KeyCompare> running_;                       // keys being fetched
+  size_t readahead_ = DEFAULT_READAHEAD;                    // chunks to fetch ahead of a scan
+  size_t issued_ = 0;                                       // fetches requested
+  size_t waited_ = 0;                                       // reads that waited on a fetch
+  bool stopping_ = false;                                   // set when the prefetcher is destroyed
+  std::vector<std::thread> workers_;
+  Lock lock_;
+
+  Prefetcher() = default;
+
+  ~Prefetcher()
+  {
+    lock_.lock();
+    stopping_ = true;
+    queue_.clear();
+    queued_.clear();
+    lock_.unlock();
+    lock_.notify_all();
+    for (std::thread &worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+  /** Returns true once the prefetcher is being destroyed. */
+  bool stopping()
+  {
+    lock_.lock();
+    bool res = stopping_;
+    lock_.unlock();
+    return res;
+  }
+
+  /** Sets how many chunks scans fetch ahead; 0 turns prefetching off. */
+  void set_readahead(size_t readahead) { readahead_ = readahead; }
+
+  /** Queues job, which fetches the chunk under k, unless k is already being
+   * fetched. Returns true if the job was queued. */
+  bool fetch(const Key &k, std::function<void()> job)
+  {
+    lock_.lock();
+    if (stopping_ || queued_.count(k) || running_.count(k))
+    {
+      lock_.unlock();
+      return false;
+    }
+    if (workers_.empty())
+    {
+      for (size_t i = 0; i < NUM_WORKERS; i++)
+      {
+        workers_.emplace_back([this] { run_(); });
+      }
+    }
+    queue_.push_back(k);
+    queued_.emplace(k, std::move(job));
+    issued_++;
+    lock_.unlock();
+    lock_.notify_all();
+    return true;
+  }
+
+  /**
+   * Called by a reader about to fetch the chunk under k. If a worker is
+   * fetching it, waits until it is done and returns true: the chunk is then
+   * cached, unless it has already been evicted. A fetch still queued is
+   * cancelled. Returns false if the reader has to fetch the chunk itself.
+   */
+  bool wait(const Key &k)
+  {
+    lock_.lock();
+    if (queued_.erase(k))
+    {
+      for (auto it = queue_.begin(); it != queue_.end(); ++it)
+      {
+        if (!KeyCompare()(*it, k) && !KeyCompare()(k, *it))
+        {
+          queue_.erase(it);
+          break;
+        }
+      }
+      lock_.unlock();
+      return false;
+    }
+    bool res = running_.count(k) > 0;
+    waited_ += res;
+    while (running_.count(k))
+    {
+      lock_.wait();
+    }
+    lock_.unlock();
+    return res;
+  }
+
+private:
+  /** A worker: runs queued jobs until the prefetcher is destroyed. */
+  void run_()
+  {
+    while (true)
+    {
+      lock_.lock();
+      while (queue_.empty() && !stopping_)
+      {
+        lock_.wait();
+      }
+      if (stopping_)
+      {
+        lock_.unlock();
+        return;
+      }
+      Key k = queue_.front();
+      queue_.pop_front();
+      auto search = queued_.find(k);
+      std::function<void()> job = std::move(search->second);
+      queued_.erase(search);
+      running_.insert(k);
+      lock_.unlock();
+
+      try
+      {
+        job();
+      }
+      catch (...)
+      {
+      }
+
+      lock_.lock();
+      running_.erase(k);
+      lock_.unlock();
+      lock_.notify_all();
+    }
+  }
+};
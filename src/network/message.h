@@ -117,7 +117,7 @@ public:
   virtual void print()
   {
     std::cout << "[PUT] from " << sender_ << " to " << target_
-              << ", key name: " << k_.name_ << std::endl;
+              << ", key name: " << k_.to_string() << std::endl;
   }
 };
 
@@ -143,7 +143,7 @@ public:
   virtual void print()
   {
     std::cout << "[GET] from " << sender_ << " to " << target_
-              << ", key name: " << k_.name_ << std::endl;
+              << ", key name: " << k_.to_string() << std::endl;
   }
 };
 
@@ -153,24 +153,17 @@ public:
 class Reply : public Message
 {
 public:
-  char *data_;
-  size_t len_;
+  Value v_; // the requested value, empty if the key was not found
 
-  Reply(MsgKind kind, size_t sender, size_t target, size_t id, char *data,
-        size_t len)
-      : Message(kind, sender, target, id), data_(data), len_(len){};
+  Reply(MsgKind kind, size_t sender, size_t target, size_t id, Value &v)
+      : Message(kind, sender, target, id), v_(v){};
 
-  Reply(Deserializer &d) : Message(d)
-  {
-    len_ = d.read_size_t();
-    data_ = d.read_chars(len_);
-  }
+  Reply(Deserializer &d) : Message(d), v_(*Value::deserialize(d)) {}
 
   void serialize(Serializer &ser)
   {
     Message::serialize(ser);
-    ser.write_size_t(len_);
-    ser.write_chars(data_, len_);
+    v_.serialize(ser);
   }
 
   virtual void print()
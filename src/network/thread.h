@@ -5,6 +5,7 @@
 // lang::Cpp
 
 #pragma once
+#include <chrono>
 #include <condition_variable>
 #include <cstdlib>
 #include <mutex>
@@ -79,6 +80,9 @@ public:
    */
   void wait() { cv_.wait(mtx_); }
 
+  /** Like wait, but also wakes up once ms milliseconds have passed. */
+  void wait_for(size_t ms) { cv_.wait_for(mtx_, std::chrono::milliseconds(ms)); }
+
   // Notify all threads waiting on this lock
   void notify_all() { cv_.notify_all(); }
 };
@@ -0,0 +1,224 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "serial.h"
+
+/**
+ * BitmapView::
+ *
+ * A read-only view of packed bits owned by someone else (a Bitmap, or the
+ * validity words of a stored chunk). A view without words stands for a
+ * bitmap with every bit set, which is how chunks without missing values
+ * are stored.
+ */
+class BitmapView
+{
+public:
+  const uint64_t *words_; // packed bits, nullptr if every bit is set
+  size_t sz_;             // number of bits
+
+  BitmapView(const uint64_t *words, size_t sz) : words_(words), sz_(sz) {}
+
+  /** Number of bits in the view. */
+  size_t size() const { return sz_; }
+
+  /** Returns the bit at idx. An idx >= size is undefined. */
+  bool test(size_t idx) const
+  {
+    return !words_ || ((words_[idx / 64] >> (idx % 64)) & 1);
+  }
+
+  /** Returns true if every bit in the view is known to be set. */
+  bool all() const { return !words_; }
+
+  /** Returns the 64 bits starting at bit 64 * w. */
+  uint64_t word(size_t w) const { return words_ ? words_[w] : ~0ULL; }
+
+  /** Returns the number of set bits. */
+  size_t count() const
+  {
+    if (!words_)
+    {
+      return sz_;
+    }
+    size_t res = 0;
+    for (size_t i = 0; i < (sz_ + 63) / 64; i++)
+    {
+      res += __builtin_popcountll(words_[i]);
+    }
+    return res;
+  }
+};
+
+/**
+ * Bitmap::
+ *
+ * A growable array of bits, packed 64 to a word. Bits past the end of the
+ * bitmap are always zero, so counting set bits is a popcount over the words.
+ * Columns use one of these per chunk as a validity map: a set bit means the
+ * value at that index is present, a cleared bit means it is missing.
+ */
+class Bitmap
+{
+public:
+  std::vector<uint64_t> words_; // packed bits, least significant bit first
+  size_t sz_ = 0;               // number of bits in the bitmap
+
+  Bitmap() = default;
+
+  /** Creates a bitmap of sz bits, all set to val. */
+  Bitmap(size_t sz, bool val) : words_((sz + 63) / 64, val ? ~0ULL : 0), sz_(sz)
+  {
+    clear_tail_();
+  }
+
+  Bitmap(std::vector<uint64_t> words, size_t sz) : words_(words), sz_(sz) {}
+
+  /** Number of bits in the bitmap. */
+  size_t size() const { return sz_; }
+
+  /** Appends a bit to the end of the bitmap. */
+  void push_back(bool b)
+  {
+    if (sz_ % 64 == 0)
+    {
+      words_.push_back(0);
+    }
+    if (b)
+    {
+      words_[sz_ / 64] |= 1ULL << (sz_ % 64);
+    }
+    sz_++;
+  }
+
+  /** Sets the bit at idx. An idx >= size is undefined. */
+  void set(size_t idx, bool b)
+  {
+    if (b)
+    {
+      words_[idx / 64] |= 1ULL << (idx % 64);
+    }
+    else
+    {
+      words_[idx / 64] &= ~(1ULL << (idx % 64));
+    }
+  }
+
+  /** Returns the bit at idx. An idx >= size is undefined. */
+  bool test(size_t idx) const
+  {
+    return (words_[idx / 64] >> (idx % 64)) & 1;
+  }
+
+  /** Returns the number of set bits. */
+  size_t count() const
+  {
+    size_t res = 0;
+    for (uint64_t w : words_)
+    {
+      res += __builtin_popcountll(w);
+    }
+    return res;
+  }
+
+  /** Returns true if every bit in the bitmap is set. */
+  bool all() const { return count() == sz_; }
+
+  /** Bitwise and, or and not, in place and a word at a time. Other must be
+   * the same size as this bitmap. */
+  void and_with(BitmapView other)
+  {
+    if (other.all())
+    {
+      return;
+    }
+    for (size_t i = 0; i < words_.size(); i++)
+    {
+      words_[i] &= other.words_[i];
+    }
+  }
+
+  void or_with(BitmapView other)
+  {
+    for (size_t i = 0; i < words_.size(); i++)
+    {
+      words_[i] |= other.word(i);
+    }
+    clear_tail_();
+  }
+
+  void flip()
+  {
+    for (uint64_t &w : words_)
+    {
+      w = ~w;
+    }
+    clear_tail_();
+  }
+
+  /** Appends the bits of other to the end of this bitmap, a word at a time. */
+  void append(BitmapView other)
+  {
+    size_t shift = sz_ % 64;
+    size_t other_words = (other.size() + 63) / 64;
+    for (size_t i = 0; i < other_words; i++)
+    {
+      uint64_t w = other.word(i);
+      if (shift == 0)
+      {
+        words_.push_back(w);
+      }
+      else
+      {
+        words_.back() |= w << shift;
+        words_.push_back(w >> (64 - shift));
+      }
+    }
+    sz_ += other.size();
+    words_.resize((sz_ + 63) / 64);
+    clear_tail_();
+  }
+
+  /** Returns a read-only view of this bitmap's words. */
+  BitmapView view() const { return BitmapView(words_.data(), sz_); }
+
+  /** Removes every bit from the bitmap. */
+  void clear()
+  {
+    words_.clear();
+    sz_ = 0;
+  }
+
+  /** Serializes the bit count followed by the packed words. */
+  void serialize(Serializer &ser) const
+  {
+    ser.write_size_t(sz_);
+    ser.write_chars((char *)words_.data(), words_.size() * sizeof(uint64_t));
+  }
+
+  static Bitmap deserialize(Deserializer &dser)
+  {
+    Bitmap res;
+    res.sz_ = dser.read_size_t();
+    res.words_.resize((res.sz_ + 63) / 64);
+    dser.read_bytes(res.words_.data(), res.words_.size() * sizeof(uint64_t));
+    return res;
+  }
+
+private:
+  /** Zeroes the unused bits of the last word. */
+  void clear_tail_()
+  {
+    if (sz_ % 64 != 0)
+    {
+      words_.back() &= (1ULL << (sz_ % 64)) - 1;
+    }
+  }
+};
@@ -6,10 +6,19 @@
 // lang::Cpp
 
 #pragma once
+#include <map>
+#include <vector>
 #include "../dataframe/row.h"
+#include "serial.h"
 
 /**
  * Generic Reader class that can be overridden;
+ *
+ * Readers mapped over a distributed dataframe see only the rows stored on
+ * their own node. To combine the per-node results, a reader serializes its
+ * result on every node, and node 0 joins the results of the other nodes
+ * into its own reader. Readers that do not override these methods are
+ * simply run over each node's rows.
  */
 class Reader
 {
@@ -18,6 +27,18 @@ public:
   Reader(const Reader &other) = default;
   virtual ~Reader() = default;
   virtual bool visit(Row &row) { return false; }
+
+  /** The columns this reader reads. Dataframes only fetch and fill these
+   * columns of the rows they visit; the other fields of the row are left
+   * unchanged. An empty list, the default, means every column. */
+  virtual std::vector<size_t> columns() { return {}; }
+
+  /** Serializes the result of this reader so far. */
+  virtual void serialize(Serializer &ser) {}
+
+  /** Joins a result serialized by a copy of this reader on another node
+   * into this reader. */
+  virtual void join(Deserializer &dser) {}
 };
 
 /****************************************************************************/
@@ -37,6 +58,8 @@ public:
   Adder(std::map<std::string, int> map) : map_(map) {}
   virtual ~Adder() = default;
 
+  std::vector<size_t> columns() { return {0}; }
+
   /**
    * Updates this map with the pair present in the given Row. The 
    * row must not be malformed. Otherwise, there will be undefined
@@ -59,4 +82,26 @@ public:
     }
     return true;
   }
+
+  /** Serializes the number of words, then each word and its count. */
+  void serialize(Serializer &ser)
+  {
+    ser.write_size_t(map_.size());
+    for (auto &entry : map_)
+    {
+      ser.write_string(entry.first);
+      ser.write_int(entry.second);
+    }
+  }
+
+  /** Adds the counts of another adder's words to this one's. */
+  void join(Deserializer &dser)
+  {
+    size_t num_words = dser.read_size_t();
+    for (size_t i = 0; i < num_words; i++)
+    {
+      std::string word = dser.read_string();
+      map_[word] += dser.read_int();
+    }
+  }
 };
@@ -31,12 +31,15 @@ public:
     delete[] data_;
   }
 
-  /** Doubles data capacity when it runs out of room */
+  /** Doubles data capacity until add_len more bytes fit */
   void grow(size_t add_len)
   {
     if (length_ + add_len > capacity_)
     {
-      capacity_ = 2 * capacity_;
+      while (length_ + add_len > capacity_)
+      {
+        capacity_ = 2 * capacity_;
+      }
       char *new_data = new char[capacity_];
       memcpy(new_data, data_, length_);
       delete[] data_;
@@ -59,6 +62,14 @@ public:
     length_ += len;
   }
 
+  /** Appends len raw bytes, used for arrays of fixed-width values */
+  void write_bytes(const void *v, size_t len)
+  {
+    grow(len);
+    memcpy(data_ + length_, v, len);
+    length_ += len;
+  }
+
   void write_int(int v)
   {
     grow(sizeof(int));
@@ -80,10 +91,10 @@ public:
     length_ += sizeof(double);
   }
 
-  void write_string(std::string s)
+  void write_string(const std::string &s)
   {
     write_size_t(s.length());
-    write_chars(strdup(s.c_str()), s.length());
+    write_bytes(s.data(), s.length());
   }
 
   void write_sockaddr_in(sockaddr_in si)
@@ -96,22 +107,16 @@ public:
   }
 
   // Vectors of primitives
-  void write_double_vector(std::vector<double> v)
+  void write_double_vector(const std::vector<double> &v)
   {
     write_size_t(v.size());
-    for (size_t i = 0; i < v.size(); i++)
-    {
-      write_double(v.at(i));
-    }
+    write_bytes(v.data(), v.size() * sizeof(double));
   }
 
-  void write_int_vector(std::vector<int> v)
+  void write_int_vector(const std::vector<int> &v)
   {
     write_size_t(v.size());
-    for (size_t i = 0; i < v.size(); i++)
-    {
-      write_int(v.at(i));
-    }
+    write_bytes(v.data(), v.size() * sizeof(int));
   }
 
   void write_size_t_vector(std::vector<size_t> v)
@@ -123,16 +128,22 @@ public:
     }
   }
 
-  void write_bool_vector(std::vector<bool> v)
+  /** Bools are packed 64 to a word, least significant bit first */
+  void write_bool_vector(const std::vector<bool> &v)
   {
     write_size_t(v.size());
-    for (size_t i = 0; i < v.size(); i++)
+    for (size_t w = 0; w < (v.size() + 63) / 64; w++)
     {
-      write_bool(v.at(i));
+      uint64_t word = 0;
+      for (size_t i = w * 64; i < v.size() && i < (w + 1) * 64; i++)
+      {
+        word |= (uint64_t)v[i] << (i % 64);
+      }
+      write_bytes(&word, sizeof(word));
     }
   }
 
-  void write_string_vector(std::vector<std::string> v)
+  void write_string_vector(const std::vector<std::string> &v)
   {
     write_size_t(v.size());
     for (size_t i = 0; i < v.size(); i++)
@@ -207,6 +218,13 @@ public:
     return res;
   }
 
+  /** Copies the next len bytes into dst, which must have room for them */
+  void read_bytes(void *dst, size_t len)
+  {
+    memcpy(dst, data_ + index_, len);
+    index_ += len;
+  }
+
   bool read_bool()
   {
     bool v;
@@ -234,8 +252,8 @@ public:
   std::string read_string()
   {
     size_t len = read_size_t();
-    char *chars = read_chars(len);
-    std::string res = std::string(chars);
+    std::string res(data_ + index_, len);
+    index_ += len;
     return res;
   }
 
@@ -256,10 +274,15 @@ public:
   std::vector<bool> read_bool_vector()
   {
     size_t vector_size = read_size_t();
-    std::vector<bool> res;
-    for (size_t i = 0; i < vector_size; i++)
+    std::vector<bool> res(vector_size);
+    for (size_t w = 0; w < (vector_size + 63) / 64; w++)
     {
-      res.push_back(read_bool());
+      uint64_t word;
+      read_bytes(&word, sizeof(word));
+      for (size_t i = w * 64; i < vector_size && i < (w + 1) * 64; i++)
+      {
+        res[i] = (word >> (i % 64)) & 1;
+      }
     }
     return res;
   }
@@ -278,22 +301,16 @@ public:
   std::vector<int> read_int_vector()
   {
     size_t vector_size = read_size_t();
-    std::vector<int> res;
-    for (size_t i = 0; i < vector_size; i++)
-    {
-      res.push_back(read_int());
-    }
+    std::vector<int> res(vector_size);
+    read_bytes(res.data(), vector_size * sizeof(int));
     return res;
   }
 
   std::vector<double> read_double_vector()
   {
     size_t vector_size = read_size_t();
-    std::vector<double> res;
-    for (size_t i = 0; i < vector_size; i++)
-    {
-      res.push_back(read_double());
-    }
+    std::vector<double> res(vector_size);
+    read_bytes(res.data(), vector_size * sizeof(double));
     return res;
   }
 
@@ -0,0 +1,41 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cstddef>
+
+/**
+ * Span::
+ *
+ * A non-owning view of a contiguous run of T, standing in for C++20's
+ * std::span. The memory is owned by whoever handed out the span and is only
+ * valid for as long as they say so (for chunk scans, the duration of the
+ * callback).
+ */
+template <typename T>
+class Span
+{
+public:
+  T *data_;     // first element, not owned
+  size_t size_; // number of elements
+
+  Span() : data_(nullptr), size_(0) {}
+
+  Span(T *data, size_t size) : data_(data), size_(size) {}
+
+  T *data() const { return data_; }
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  T &operator[](size_t idx) const { return data_[idx]; }
+
+  T *begin() const { return data_; }
+
+  T *end() const { return data_ + size_; }
+};
@@ -0,0 +1,91 @@
+/*
+ * Authors: Brian Yeung, Daniel Gao
+ * Emails: yeung.bri@husky.neu.edu, gao.d@husky.neu.edu
+ */
+
+// lang::Cpp
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "serial.h"
+
+/**
+ * StringArena::
+ *
+ * A sequence of strings stored back to back in one contiguous byte buffer,
+ * with an array of offsets saying where each string starts. String i spans
+ * bytes_[offsets_[i], offsets_[i + 1]). Adding a string only grows the two
+ * buffers, and reading one returns a view into the buffer, so neither
+ * allocates per string. Views are invalidated when the arena is changed.
+ *
+ * Serialized, an arena is its count, the offsets and then the bytes, each
+ * written with a single copy. The offsets are 64-bit so that they can be
+ * read in place out of a serialized chunk (see ColumnChunkView).
+ */
+class StringArena
+{
+public:
+  std::string bytes_;                   // the strings, back to back
+  std::vector<uint64_t> offsets_ = {0}; // one more offset than strings
+
+  StringArena() = default;
+
+  StringArena(const std::vector<std::string> &strs)
+  {
+    for (auto &str : strs)
+    {
+      push_back(str);
+    }
+  }
+
+  /** Number of strings in the arena. */
+  size_t size() const { return offsets_.size() - 1; }
+
+  /** Appends a copy of str to the arena. */
+  void push_back(std::string_view str)
+  {
+    bytes_.append(str.data(), str.size());
+    offsets_.push_back(bytes_.size());
+  }
+
+  /** Returns a view of the string at idx. An idx >= size is undefined. */
+  std::string_view get(size_t idx) const
+  {
+    return std::string_view(bytes_.data() + offsets_[idx], offsets_[idx + 1] - offsets_[idx]);
+  }
+
+  std::string_view operator[](size_t idx) const { return get(idx); }
+
+  /** Removes every string, keeping the buffers' capacity. */
+  void clear()
+  {
+    bytes_.clear();
+    offsets_.resize(1);
+  }
+
+  bool operator==(const StringArena &other) const
+  {
+    return offsets_ == other.offsets_ && bytes_ == other.bytes_;
+  }
+
+  /** Writes the number of strings, the offsets and the bytes. */
+  void serialize(Serializer &ser) const
+  {
+    ser.write_size_t(size());
+    ser.write_bytes(offsets_.data(), offsets_.size() * sizeof(uint64_t));
+    ser.write_bytes(bytes_.data(), bytes_.size());
+  }
+
+  static StringArena deserialize(Deserializer &dser)
+  {
+    StringArena res;
+    res.offsets_.resize(dser.read_size_t() + 1);
+    dser.read_bytes(res.offsets_.data(), res.offsets_.size() * sizeof(uint64_t));
+    res.bytes_.resize(res.offsets_.back());
+    dser.read_bytes(&res.bytes_[0], res.bytes_.size());
+    return res;
+  }
+};
@@ -6,10 +6,13 @@
 //lang::Cpp
 
 #include <gtest/gtest.h>
+#include <climits>
+#include <map>
 #include <iostream>
 #include <string>
 #include <vector>
 #include "../src/dataframe/dataframe.h"
+#include "../src/dataframe/typed_dataframe.h"
 #include "../src/dataframe/wrapper.h"
 
 /**
@@ -342,6 +345,51 @@ TEST(dataframe, testFillRow)
   EXPECT_EQ(filledR2.get_string(2), apple);
 }
 
+// Tests that a reused row stops growing its string arena
+TEST(dataframe, testFlatRow)
+{
+  Schema schema("SIS");
+  Row r(schema);
+  EXPECT_TRUE(r.is_missing(0));
+  EXPECT_EQ(r.get_string(0), "");
+  EXPECT_EQ(r.width(), 3);
+  EXPECT_EQ(r.col_type(1), 'I');
+
+  r.set(0, String(orange));
+  r.set(1, Int(7));
+  r.set(2, String(s4));
+  size_t arena = r._arena.size();
+  for (size_t i = 0; i < 100; i++)
+  {
+    r.set_string(0, i % 2 == 0 ? apple : s3);
+    r.set_missing(2);
+    r.set_string(2, i % 2 == 0 ? s2 : empty_string);
+  }
+  EXPECT_EQ(r._arena.size(), arena);
+  EXPECT_EQ(r.get_string_view(0), s3);
+  EXPECT_EQ(r.get_string(2), empty_string);
+  EXPECT_EQ(r.get_int(1), 7);
+
+  // longer strings move to a bigger region, without disturbing the others
+  r.set_string(2, s1 + s1 + s1);
+  EXPECT_EQ(r.get_string(0), s3);
+  EXPECT_EQ(r.get_string(2), s1 + s1 + s1);
+
+  Row copy(r);
+  r.set_string(0, pear);
+  EXPECT_EQ(copy.get_string(0), s3);
+  EXPECT_EQ(r.get_string(0), pear);
+  r.set_missing(1);
+  EXPECT_EQ(r.get_int(1), 0);
+
+  // a field copied from another field of the row survives the arena growing
+  std::string big = r.get_string(2);
+  r._arena.shrink_to_fit();
+  r.set_string(0, r.get_string_view(2));
+  EXPECT_EQ(r.get_string(0), big);
+  EXPECT_EQ(r.get_string(2), big);
+}
+
 // Tests the dataframe's map functionality
 TEST(dataframe, testMap)
 {
@@ -365,6 +413,793 @@ TEST(dataframe, testMap)
   EXPECT_EQ(intRower._sum, 1000000);
 }
 
+// Tests counting and masking packed bool columns across chunks
+TEST(dataframe, testBoolColumn)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  BoolColumn bc;
+  size_t n = 3 * MAX_CHUNK_SIZE + 100;
+  size_t trues = 0;
+  size_t falses = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    bc.push_back(i % 3 == 0, store);
+    if (i % 7 == 0)
+    {
+      bc.mark_missing(i);
+    }
+    else
+    {
+      trues += i % 3 == 0;
+      falses += i % 3 != 0;
+    }
+  }
+  EXPECT_EQ(bc.count_true(store), trues);
+  EXPECT_EQ(bc.count_false(store), falses);
+
+  Bitmap mask = bc.mask(store);
+  ASSERT_EQ(mask.size(), n);
+  EXPECT_EQ(mask.count(), trues);
+  for (size_t i = 0; i < n; i++)
+  {
+    ASSERT_EQ(mask.test(i), i % 3 == 0 && i % 7 != 0);
+    ASSERT_EQ(bc.get(i, store), i % 3 == 0);
+  }
+
+  // a stored chunk of bools takes one bit per value
+  Value v = store->get(bc.keys_.at(0));
+  EXPECT_LT(v.length(), 2 * MAX_CHUNK_SIZE / 8 + 64);
+
+  mask.flip();
+  EXPECT_EQ(mask.count(), n - trues);
+}
+
+// Tests equality matches on string columns with dictionary-encoded chunks
+TEST(dataframe, testStringMatch)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  StringColumn sc;
+  size_t n = 2 * MAX_CHUNK_SIZE + 300;
+  size_t apples = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    sc.push_back(i % 4 == 0 ? apple : pear, store);
+    if (i % 10 == 0)
+    {
+      sc.mark_missing(i);
+    }
+    else
+    {
+      apples += i % 4 == 0;
+    }
+  }
+  ASSERT_TRUE(sc.get_chunk_(0, store)->is_dict());
+
+  Bitmap matches = sc.match(apple, store);
+  ASSERT_EQ(matches.size(), n);
+  EXPECT_EQ(matches.count(), apples);
+  EXPECT_EQ(sc.count_equal(apple, store), apples);
+  EXPECT_EQ(sc.count_equal("plum", store), 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    ASSERT_EQ(matches.test(i), i % 4 == 0 && i % 10 != 0);
+    ASSERT_EQ(sc.get(i, store), i % 4 == 0 ? apple : pear);
+  }
+}
+
+// Tests that pmap gives the same results as map over several chunks
+TEST(dataframe, testPmap)
+{
+  Schema s("IS");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrame df(s);
+  Row r(df.get_schema());
+  size_t n = 5 * MAX_CHUNK_SIZE + 123;
+  for (size_t i = 0; i < n; i++)
+  {
+    r.set(0, Int(i));
+    r.set(1, String(i % 2 == 0 ? apple : pear));
+    df.add_row(r, store);
+  }
+
+  IntSumRower sum, psum;
+  df.map(sum, store);
+  df.pmap(psum, store);
+  EXPECT_EQ(psum._sum, n * (n - 1) / 2);
+  EXPECT_EQ(psum._sum, sum._sum);
+
+  CounterRower count, pcount;
+  df.map(count, store);
+  df.pmap(pcount, store);
+  EXPECT_EQ(pcount._count, 2 * n);
+  EXPECT_EQ(pcount._count, count._count);
+
+  CharCountRower chars('p'), pchars('p');
+  df.map(chars, store);
+  df.pmap(pchars, store);
+  EXPECT_EQ(pchars._count, (n + 1) / 2 * 2 + n / 2);
+  EXPECT_EQ(pchars._count, chars._count);
+
+  // rowers that cannot be cloned fall back to a serial map
+  StringSearchRower search("apple");
+  df.pmap(search, store);
+}
+
+// Tests filters and running rowers over their selections
+TEST(dataframe, testFilter)
+{
+  Schema s("ISBD");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrame df(s);
+  Row r(df.get_schema());
+  size_t n = 2 * MAX_CHUNK_SIZE + 50;
+  for (size_t i = 0; i < n; i++)
+  {
+    r.set(0, Int(i));
+    r.set(1, String(i % 3 == 0 ? apple : pear));
+    r.set(2, Bool(i % 2 == 0));
+    r.set(3, Double(i * 0.25));
+    df.add_row(r, store);
+  }
+
+  StringSearchRower search("apple");
+  Selection apples = df.filter(search, store);
+  ASSERT_EQ(apples.size(), (n + 2) / 3);
+  EXPECT_EQ(apples[1], 3);
+
+  auto typed = df.filter<std::string_view>(1, [](std::string_view v) { return v == "apple"; }, store);
+  EXPECT_EQ(typed, apples);
+
+  auto big = df.filter<int>(0, [](int v) { return v >= (int)MAX_CHUNK_SIZE; }, store);
+  EXPECT_EQ(big.size(), n - MAX_CHUNK_SIZE);
+  auto evens = df.filter<bool>(2, [](bool v) { return v; }, store);
+  EXPECT_EQ(evens.size(), (n + 1) / 2);
+  auto small = df.filter<double>(3, [](double v) { return v < 2; }, store);
+  EXPECT_EQ(small.size(), 8);
+  EXPECT_THROW(df.filter<int>(3, [](int v) { return true; }, store), std::runtime_error);
+
+  // rows divisible by 6, at or past the first stored chunk
+  Selection both = big.intersect(apples).intersect(evens);
+  EXPECT_EQ(both[0], MAX_CHUNK_SIZE + 2);
+  EXPECT_EQ(Selection(both.to_bitmap(n).view()), both);
+
+  IntSumRower sum;
+  df.map(sum, both, store);
+  size_t expected = 0;
+  for (size_t i = 0; i < both.size(); i++)
+  {
+    expected += both[i];
+  }
+  EXPECT_EQ(sum._sum, expected);
+}
+
+// Sums column 0 only, and says so
+class FirstColumnSumRower : public Rower
+{
+public:
+  size_t sum_ = 0;
+
+  bool accept(Row &r)
+  {
+    sum_ += r.get_int(0);
+    return true;
+  }
+
+  std::vector<size_t> columns() { return {0}; }
+};
+
+// Tests that projected scans only fetch the chunks of their columns
+TEST(dataframe, testProjection)
+{
+  Schema s("IIIII");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrame df(s);
+  Row r(df.get_schema());
+  size_t n = 3 * MAX_CHUNK_SIZE + 1; // three stored chunks per column
+  for (size_t i = 0; i < n; i++)
+  {
+    for (size_t j = 0; j < 5; j++)
+    {
+      r.set(j, Int(i * (j + 1)));
+    }
+    df.add_row(r, store);
+  }
+
+  size_t misses = store->chunk_cache_.misses_;
+  FirstColumnSumRower sum;
+  df.map(sum, store);
+  EXPECT_EQ(sum.sum_, n * (n - 1) / 2);
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 3);
+
+  IntSumRower all;
+  df.map(all, {2}, store);
+  EXPECT_EQ(all._sum, 3 * n * (n - 1) / 2);
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 6);
+
+  // unprojected fields are left alone
+  Row row(df.get_schema());
+  row.set(1, Int(-1));
+  df.fill_row(MAX_CHUNK_SIZE + 1, row, {0, 4}, store);
+  EXPECT_EQ(row.get_int(0), MAX_CHUNK_SIZE + 1);
+  EXPECT_EQ(row.get_int(1), -1);
+  EXPECT_EQ(row.get_int(4), 5 * (MAX_CHUNK_SIZE + 1));
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 7);
+
+  EXPECT_THROW(df.fill_row(0, row, {5}, store), std::runtime_error);
+}
+
+// Fills a typed column past its first chunk with make(i), then checks it
+// through the code shared by every TypedColumn
+template <typename T, typename C, typename F>
+void checkTypedColumn(C &col, F make, std::shared_ptr<KVStore> store)
+{
+  size_t n = MAX_CHUNK_SIZE + 10;
+  for (size_t i = 0; i < n; i++)
+  {
+    col.push_back(make(i), store);
+  }
+  Column &base = col;
+  EXPECT_EQ(base.get_type(), ColumnTraits<T>::TYPE);
+  EXPECT_EQ(col.get(3, store), make(3));
+  EXPECT_EQ(col.get(n - 1, store), make(n - 1));
+
+  ColumnCursor cursor(&col, store);
+  size_t seen = 0;
+  col.for_each_chunk(store, [&](typename ColumnTraits<T>::Values vals, BitmapView validity, size_t start) {
+    for (size_t i = 0; i < vals.size(); i += 999)
+    {
+      EXPECT_EQ(T(ColumnTraits<T>::value_at(vals, i)), make(start + i));
+      EXPECT_EQ(T(cursor.get<T>(start + i)), make(start + i));
+    }
+    seen += vals.size();
+  });
+  EXPECT_EQ(seen, n);
+}
+
+// Tests that every column type goes through the shared template
+TEST(dataframe, testTypedColumn)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  checkTypedColumn<int>(ic, [](size_t i) { return (int)i * 3; }, store);
+  DoubleColumn dc;
+  checkTypedColumn<double>(dc, [](size_t i) { return i * 0.5; }, store);
+  BoolColumn bc;
+  checkTypedColumn<bool>(bc, [](size_t i) { return i % 3 == 0; }, store);
+  StringColumn sc;
+  checkTypedColumn<std::string>(sc, [](size_t i) { return std::to_string(i); }, store);
+}
+
+// Tests typed frames, and sharing them with untyped code
+TEST(dataframe, testTypedDataFrame)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  TypedDataFrame<int, double, bool, std::string> tdf;
+  size_t n = MAX_CHUNK_SIZE + 20;
+  for (size_t i = 0; i < n; i++)
+  {
+    tdf.add_row(i, i * 0.5, i % 2 == 0, i % 3 == 0 ? apple : pear, store);
+  }
+  EXPECT_EQ(tdf.nrows(), n);
+  EXPECT_EQ(tdf.get<3>(3, store), apple);
+
+  size_t sum = 0, evens = 0, apples = 0;
+  double halves = 0;
+  tdf.for_each([&](const std::tuple<int, double, bool, std::string_view> &row) {
+    sum += std::get<0>(row);
+    halves += std::get<1>(row);
+    evens += std::get<2>(row);
+    apples += std::get<3>(row) == apple;
+  }, store);
+  EXPECT_EQ(sum, n * (n - 1) / 2);
+  EXPECT_DOUBLE_EQ(halves, sum * 0.5);
+  EXPECT_EQ(evens, (n + 1) / 2);
+  EXPECT_EQ(apples, (n + 2) / 3);
+
+  // the serialized frame reads back untyped, and the untyped one typed
+  Serializer ser;
+  tdf.serialize(ser);
+  Deserializer dser(ser.data(), ser.length());
+  auto df = DataFrame::deserialize(dser);
+  EXPECT_EQ(df->get_int(0, n - 1, store), n - 1);
+  EXPECT_EQ(df->get_string(3, 1, store), pear);
+
+  TypedDataFrame<int, double, bool, std::string> again(df);
+  EXPECT_EQ(again.get<0>(MAX_CHUNK_SIZE + 1, store), MAX_CHUNK_SIZE + 1);
+  EXPECT_THROW((TypedDataFrame<int, int, bool, std::string>(df)), std::runtime_error);
+  EXPECT_THROW((TypedDataFrame<int, double, bool>(df)), std::runtime_error);
+}
+
+// Tests columns whose chunks are cut by size in bytes, not rows
+TEST(dataframe, testChunkSizing)
+{
+  Schema s("IS");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  store->chunk_sizing_.set_target('S', 4096);
+  DataFrame df(s);
+  Row r(df.get_schema());
+  size_t n = MAX_CHUNK_SIZE + 500;
+  for (size_t i = 0; i < n; i++)
+  {
+    r.set(0, Int(i));
+    r.set(1, String(std::string(i % 50, 'x')));
+    df.add_row(r, store);
+    if (i % 7 == 0)
+    {
+      df.cols_[1]->mark_missing(i);
+    }
+  }
+
+  auto sc = df.cols_[1]->as_string();
+  EXPECT_EQ(df.cols_[0]->keys_.size(), 1);
+  ASSERT_GT(sc->keys_.size(), 50);
+  ASSERT_EQ(sc->offsets_.size(), sc->keys_.size() + 1);
+  for (size_t i = 0; i + 1 < sc->offsets_.size(); i++)
+  {
+    EXPECT_LT(sc->offsets_[i], sc->offsets_[i + 1]);
+  }
+
+  // random access, cursors and chunk scans all agree on the row numbers
+  for (size_t i = 0; i < n; i += 97)
+  {
+    EXPECT_EQ(sc->get(i, store), std::string(i % 50, 'x'));
+    EXPECT_EQ(sc->is_missing(i, store), i % 7 == 0);
+  }
+  size_t rows = 0;
+  sc->for_each_chunk(store, [&](Span<const std::string_view> vals, BitmapView validity, size_t start) {
+    EXPECT_EQ(start, rows);
+    EXPECT_EQ(vals[0].size(), start % 50);
+    rows += vals.size();
+  });
+  EXPECT_EQ(rows, n);
+
+  CharCountRower xs('x'), pxs('x');
+  df.map(xs, store);
+  df.pmap(pxs, store);
+  size_t expected = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    expected += i % 7 == 0 ? 0 : i % 50;
+  }
+  EXPECT_EQ(xs._count, expected);
+  EXPECT_EQ(pxs._count, expected);
+
+  // chunk lengths survive serialization
+  Serializer ser;
+  sc->serialize(ser);
+  Deserializer dser(ser.data(), ser.length());
+  auto sc2 = StringColumn::deserialize(dser);
+  EXPECT_EQ(sc2->offsets_, sc->offsets_);
+  EXPECT_EQ(sc2->size(), n);
+  EXPECT_EQ(sc2->get(n - 1, store), sc->get(n - 1, store));
+}
+
+// Tests that bulk appends and the builder cut the same chunks as row by row
+TEST(dataframe, testBuilder)
+{
+  Schema s("IBDS");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  store->chunk_sizing_.set_target('S', 4096);
+  DataFrame by_row(s);
+  DataFrameBuilder by_rows(s, store);
+  Row r(s);
+  size_t n = 2 * MAX_CHUNK_SIZE + 123;
+  for (size_t i = 0; i < n; i++)
+  {
+    r.set(0, Int(i));
+    r.set(1, Bool(i % 3 == 0));
+    r.set(2, Double(i / 2.0));
+    r.set(3, String(std::string(i % 20, 'y')));
+    if (i % 11 == 0)
+    {
+      r.set_missing(2);
+    }
+    by_row.add_row(r, store);
+    by_rows.add_row(r);
+  }
+  auto built = by_rows.done();
+
+  // the same values, appended in batches of uneven sizes
+  std::vector<int> ints(n);
+  std::vector<std::string> strs(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    ints[i] = i;
+    strs[i] = std::string(i % 20, 'y');
+  }
+  Schema s2("IS");
+  DataFrameBuilder by_batch(s2, store);
+  for (size_t i = 0; i < n; i += 3001)
+  {
+    size_t len = std::min(n - i, (size_t)3001);
+    by_batch.append(0, Span<const int>(ints.data() + i, len));
+    by_batch.append(1, Span<const std::string>(strs.data() + i, len));
+  }
+  auto batched = by_batch.done();
+
+  ASSERT_EQ(built->nrows(), n);
+  ASSERT_EQ(batched->nrows(), n);
+  for (size_t c = 0; c < s.width(); c++)
+  {
+    EXPECT_EQ(built->cols_[c]->offsets_, by_row.cols_[c]->offsets_);
+  }
+  EXPECT_EQ(batched->cols_[0]->offsets_, by_row.cols_[0]->offsets_);
+  EXPECT_EQ(batched->cols_[1]->offsets_, by_row.cols_[3]->offsets_);
+  EXPECT_GT(built->cols_[3]->num_chunks(), 3);
+  for (size_t i = 0; i < n; i += 89)
+  {
+    EXPECT_EQ(built->get_int(0, i, store), (int)i);
+    EXPECT_EQ(built->get_bool(1, i, store), i % 3 == 0);
+    EXPECT_EQ(built->cols_[2]->is_missing(i, store), i % 11 == 0);
+    EXPECT_EQ(built->get_string(3, i, store), std::string(i % 20, 'y'));
+    EXPECT_EQ(batched->get_int(0, i, store), (int)i);
+    EXPECT_EQ(batched->get_string(1, i, store), std::string(i % 20, 'y'));
+  }
+
+  DataFrameBuilder bad(s2, store);
+  std::vector<double> ds = {1.0};
+  EXPECT_THROW(bad.append(0, Span<const double>(ds.data(), 1)), std::runtime_error);
+  bad.append(0, Span<const int>(ints.data(), 2));
+  EXPECT_THROW(bad.done(), std::runtime_error);
+}
+
+// Tests hash group-by on string, int and composite keys against std::map
+TEST(dataframe, testGroupBy)
+{
+  Schema s("SIDB");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrameBuilder builder(s, store);
+  Row r(s);
+  size_t n = 3 * MAX_CHUNK_SIZE + 17;
+  struct Expected
+  {
+    size_t rows = 0, present = 0;
+    double sum = 0;
+    int min = INT_MAX, max = INT_MIN;
+  };
+  std::map<std::string, Expected> by_str;
+  std::map<int, Expected> by_int;
+  std::map<std::pair<std::string, int>, Expected> by_both;
+  std::vector<std::string> str_order;
+  for (size_t i = 0; i < n; i++)
+  {
+    std::string k = i % 13 == 0 ? "" : "k" + std::to_string(i % 7);
+    r.set(0, String(k));
+    if (k.empty())
+    {
+      r.set_missing(0);
+    }
+    r.set(1, Int(i % 5));
+    r.set(2, Double(i * 0.5));
+    if (i % 4 == 0)
+    {
+      r.set_missing(2);
+    }
+    r.set(3, Bool(i % 2));
+    builder.add_row(r);
+    if (!by_str.count(k))
+    {
+      str_order.push_back(k);
+    }
+    for (Expected *e : {&by_str[k], &by_int[i % 5], &by_both[{k, i % 5}]})
+    {
+      e->rows++;
+      e->min = std::min(e->min, (int)(i % 5));
+      e->max = std::max(e->max, (int)(i % 5));
+      if (i % 4 != 0)
+      {
+        e->present++;
+        e->sum += i * 0.5;
+      }
+    }
+  }
+  auto df = builder.done();
+  ASSERT_GT(df->cols_[0]->num_chunks(), 2);
+
+  // string key, groups in order of first appearance, missing keys grouped
+  auto res = df->group_by({0}).agg({Agg::count(), Agg::sum(2), Agg::min(1), Agg::max(1), Agg::mean(2), Agg::count(2)}, store);
+  ASSERT_EQ(res->nrows(), by_str.size());
+  ASSERT_EQ(res->get_schema().col_type(1), 'I');
+  ASSERT_EQ(res->get_schema().col_type(2), 'D');
+  ASSERT_EQ(res->get_schema().col_type(3), 'I');
+  for (size_t g = 0; g < res->nrows(); g++)
+  {
+    std::string k = res->cols_[0]->is_missing(g, store) ? "" : res->get_string(0, g, store);
+    EXPECT_EQ(k, str_order[g]);
+    Expected &e = by_str[k];
+    EXPECT_EQ(res->get_int(1, g, store), e.rows);
+    EXPECT_DOUBLE_EQ(res->get_double(2, g, store), e.sum);
+    EXPECT_EQ(res->get_int(3, g, store), e.min);
+    EXPECT_EQ(res->get_int(4, g, store), e.max);
+    EXPECT_DOUBLE_EQ(res->get_double(5, g, store), e.sum / e.present);
+    EXPECT_EQ(res->get_int(6, g, store), e.present);
+  }
+
+  // int key
+  res = df->group_by({1}).agg({Agg::count(), Agg::sum(2)}, store);
+  ASSERT_EQ(res->nrows(), 5);
+  for (size_t g = 0; g < 5; g++)
+  {
+    EXPECT_EQ(res->get_int(0, g, store), g);
+    EXPECT_EQ(res->get_int(1, g, store), by_int[g].rows);
+    EXPECT_DOUBLE_EQ(res->get_double(2, g, store), by_int[g].sum);
+  }
+
+  // composite key, encoded
+  res = df->group_by({0, 1}).agg({Agg::count(), Agg::max(2)}, store);
+  ASSERT_EQ(res->nrows(), by_both.size());
+  for (size_t g = 0; g < res->nrows(); g++)
+  {
+    std::string k = res->cols_[0]->is_missing(g, store) ? "" : res->get_string(0, g, store);
+    Expected &e = by_both[{k, res->get_int(1, g, store)}];
+    EXPECT_EQ(res->get_int(2, g, store), e.rows);
+  }
+
+  EXPECT_THROW(df->group_by({}), std::runtime_error);
+  EXPECT_THROW(df->group_by({9}), std::runtime_error);
+  EXPECT_THROW(df->group_by({1}).agg({Agg::sum(0)}, store), std::runtime_error);
+
+  // int values are summed exactly, past the range of an int
+  AggState big, more;
+  big.add(INT_MAX);
+  more.add(INT_MAX);
+  more.add(1);
+  big.merge(more);
+  EXPECT_EQ(big.isum_, 2L * INT_MAX + 1);
+  EXPECT_EQ(big.sum(), 2.0 * INT_MAX + 1);
+}
+
+// Records the chunks it is asked to place, and puts them all on node 0
+class RecordingPlacement : public PlacementPolicy
+{
+public:
+  std::vector<ChunkPlacement> chunks_;
+
+  size_t place(const ChunkPlacement &chunk)
+  {
+    chunks_.push_back(chunk);
+    return 0;
+  }
+};
+
+// Tests the placement policies, and that columns consult theirs
+TEST(dataframe, testPlacement)
+{
+  auto chunk = [](size_t idx, size_t first_row, size_t bytes) {
+    return ChunkPlacement{ChunkId(2, idx + 1), idx, first_row, bytes, 2, 4};
+  };
+  RoundRobinPlacement rr;
+  EXPECT_EQ(rr.place(chunk(5, 0, 0)), 1);
+  RowRangePlacement rows(1000);
+  EXPECT_EQ(rows.place(chunk(0, 2500, 0)), 2);
+  EXPECT_EQ(rows.place(chunk(9, 2999, 0)), 2);
+  EXPECT_EQ(rows.place(chunk(1, 4000, 0)), 0);
+  EXPECT_THROW(RowRangePlacement(0), std::runtime_error);
+  LocalPlacement local;
+  EXPECT_EQ(local.place(chunk(7, 0, 0)), 2);
+  HashPlacement hash;
+  EXPECT_EQ(hash.place(chunk(3, 0, 0)), hash.place(chunk(3, 10, 5)));
+  EXPECT_LT(hash.place(chunk(3, 0, 0)), 4);
+
+  LoadAwarePlacement load;
+  EXPECT_EQ(load.place(chunk(0, 0, 100)), 0);
+  EXPECT_EQ(load.place(chunk(1, 0, 10)), 1);
+  EXPECT_EQ(load.place(chunk(2, 0, 10)), 2);
+  EXPECT_EQ(load.place(chunk(3, 0, 10)), 3);
+  EXPECT_EQ(load.place(chunk(4, 0, 10)), 1);
+  EXPECT_EQ(load.place(chunk(5, 0, 500)), 2);
+  EXPECT_EQ(load.place(chunk(6, 0, 10)), 3);
+
+  // one policy, shared by every column of a dataframe
+  Schema s("ID");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrame df(s);
+  auto policy = std::make_shared<RecordingPlacement>();
+  df.set_placement(policy);
+  Row r(df.get_schema());
+  for (size_t i = 0; i < 2 * MAX_CHUNK_SIZE + 1; i++)
+  {
+    r.set(0, Int(i));
+    r.set(1, Double(i));
+    df.add_row(r, store);
+  }
+  ASSERT_EQ(policy->chunks_.size(), 4);
+  EXPECT_EQ(policy->chunks_[2].chunk_idx_, 1);
+  EXPECT_EQ(policy->chunks_[2].first_row_, MAX_CHUNK_SIZE);
+  EXPECT_EQ(policy->chunks_[2].id_, df.cols_[0]->keys_[1].id_);
+  EXPECT_GT(policy->chunks_[3].bytes_, 0);
+
+  // map ranges weigh the bytes of each column's chunks by row overlap
+  std::vector<size_t> bytes(2, 0);
+  df.cols_[0]->add_bytes_by_node(0, MAX_CHUNK_SIZE, bytes);
+  EXPECT_EQ(bytes[0], df.cols_[0]->sizes_[0]);
+  df.cols_[1]->add_bytes_by_node(MAX_CHUNK_SIZE / 2, MAX_CHUNK_SIZE, bytes);
+  EXPECT_EQ(bytes[0], df.cols_[0]->sizes_[0] + df.cols_[1]->sizes_[0] / 2);
+  EXPECT_EQ(bytes[1], 0);
+}
+
+// Tests that missing values are tracked across stored chunks and the cache
+TEST(dataframe, testMissing)
+{
+  Schema s("I");
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DataFrame df(s);
+  size_t n = 2 * MAX_CHUNK_SIZE + 10;
+  for (size_t i = 0; i < n; i++)
+  {
+    Row r(df.get_schema());
+    if (i % 7 != 0)
+    {
+      r.set(0, Int(i));
+    }
+    df.add_row(r, store);
+  }
+
+  auto col = df.cols_.at(0);
+  size_t expected_nulls = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    EXPECT_EQ(col->is_missing(i, store), i % 7 == 0);
+    expected_nulls += i % 7 == 0;
+  }
+  EXPECT_EQ(col->null_count(store), expected_nulls);
+
+  Row filled(df.get_schema());
+  df.fill_row(MAX_CHUNK_SIZE + 1, filled, store);
+  EXPECT_FALSE(filled.is_missing(0));
+  EXPECT_EQ(filled.get_int(0), MAX_CHUNK_SIZE + 1);
+  df.fill_row(7 * 2000, filled, store);
+  EXPECT_TRUE(filled.is_missing(0));
+}
+
+// Tests scanning typed columns a chunk at a time
+TEST(dataframe, testForEachChunk)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  BoolColumn bc;
+  StringColumn sc;
+  size_t n = 2 * MAX_CHUNK_SIZE + 500;
+  long expected = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    ic.push_back(i, store);
+    bc.push_back(i % 2 == 0, store);
+    sc.push_back(i % 3 == 0 ? apple : pear, store);
+    if (i % 5 == 0)
+    {
+      ic.mark_missing(i);
+    }
+    else
+    {
+      expected += i;
+    }
+  }
+
+  long sum = 0;
+  size_t seen = 0;
+  size_t chunks = 0;
+  ic.for_each_chunk(store, [&](Span<const int> vals, BitmapView validity, size_t start) {
+    EXPECT_EQ(start, seen);
+    for (size_t i = 0; i < vals.size(); i++)
+    {
+      EXPECT_EQ(validity.test(i), (start + i) % 5 != 0);
+      if (validity.test(i))
+      {
+        sum += vals[i];
+      }
+    }
+    seen += vals.size();
+    chunks++;
+  });
+  EXPECT_EQ(sum, expected);
+  EXPECT_EQ(seen, n);
+  EXPECT_EQ(chunks, 3);
+
+  size_t trues = 0;
+  bc.for_each_chunk(store, [&](BitmapView vals, BitmapView validity, size_t start) {
+    trues += vals.count();
+  });
+  EXPECT_EQ(trues, (n + 1) / 2);
+
+  size_t apples = 0;
+  sc.for_each_chunk(store, [&](Span<const std::string_view> vals, BitmapView validity, size_t start) {
+    for (auto &str : vals)
+    {
+      apples += str == apple;
+    }
+  });
+  EXPECT_EQ(apples, (n + 2) / 3);
+}
+
+// Tests the built-in aggregates against straightforward loops
+TEST(dataframe, testAggregates)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  DoubleColumn dc;
+  size_t n = MAX_CHUNK_SIZE + 777;
+  long isum = 0;
+  double dsum = 0;
+  size_t present = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    int v = (int)((i * 7919) % 2001) - 1000;
+    ic.push_back(v, store);
+    dc.push_back(v * 0.5, store);
+    // a few missing values, including some sparse words and a gap
+    if (i % 97 == 0 || (i > 300 && i < 450))
+    {
+      ic.mark_missing(i);
+      dc.mark_missing(i);
+      continue;
+    }
+    isum += v;
+    dsum += v * 0.5;
+    present++;
+  }
+  ic.push_back(5000, store); // the largest value, but missing
+  ic.mark_missing(n);
+
+  EXPECT_EQ(ic.sum(store), isum);
+  EXPECT_EQ(ic.min(store), -1000);
+  EXPECT_EQ(ic.max(store), 1000);
+  EXPECT_EQ(ic.count(), n + 1);
+  EXPECT_EQ(ic.count_non_missing(store), present);
+  EXPECT_DOUBLE_EQ(ic.mean(store), (double)isum / present);
+
+  EXPECT_DOUBLE_EQ(dc.sum(store), dsum);
+  EXPECT_DOUBLE_EQ(dc.min(store), -500);
+  EXPECT_DOUBLE_EQ(dc.max(store), 500);
+  EXPECT_EQ(dc.count_non_missing(store), present);
+  EXPECT_DOUBLE_EQ(dc.mean(store), dsum / present);
+
+  DoubleColumn empty;
+  EXPECT_TRUE(std::isnan(empty.mean(store)));
+}
+
+TEST(dataframe, testZoneMaps)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  DoubleColumn dc;
+  size_t n = 5 * MAX_CHUNK_SIZE + 10;
+  for (size_t i = 0; i < n; i++)
+  {
+    // increasing, like timestamps, so each chunk covers its own range
+    ic.push_back(i, store);
+    dc.push_back(i * 0.5, store);
+    if (i % 10 == 0)
+    {
+      ic.mark_missing(i);
+    }
+  }
+  ASSERT_EQ(ic.stats_.size(), 5);
+  EXPECT_TRUE(ic.stats_[1].has_range_);
+  EXPECT_EQ(ic.stats_[1].min_, MAX_CHUNK_SIZE + 1);
+  EXPECT_EQ(ic.stats_[1].max_, 2 * MAX_CHUNK_SIZE - 1);
+  EXPECT_EQ(ic.stats_[1].null_count_, MAX_CHUNK_SIZE / 10);
+  EXPECT_EQ(ic.null_count(store), n / 10);
+
+  // only the chunk holding [25000, 25100] is fetched
+  size_t misses = store->chunk_cache_.misses_;
+  int lo = 2 * MAX_CHUNK_SIZE + 5000;
+  EXPECT_EQ(ic.count_in_range(lo, lo + 100, store), 101 - 11);
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 1);
+  EXPECT_EQ(dc.count_in_range(lo * 0.5, (lo + 100) * 0.5, store), 101);
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 2);
+  EXPECT_EQ(ic.count_in_range(-10, -1, store), 0);
+  EXPECT_EQ(store->chunk_cache_.misses_, misses + 2);
+
+  // the cache is always scanned, since it has no zone map yet
+  EXPECT_EQ(ic.count_in_range((int)n - 5, (int)n, store), 5);
+
+  // the stored chunks hold 5 * MAX_CHUNK_SIZE distinct doubles
+  double est = dc.distinct_estimate();
+  EXPECT_GT(est, 5 * MAX_CHUNK_SIZE * 0.6);
+  EXPECT_LT(est, 5 * MAX_CHUNK_SIZE * 1.4);
+}
+
 // Runs all of the tests.
 int main(int argc, char **argv)
 {
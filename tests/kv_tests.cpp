@@ -6,6 +6,7 @@
 // lang::Cpp
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <cassert>
 #include "../src/application.h"
 
@@ -119,6 +120,301 @@ void testSimpleKV()
 
 TEST(simpleKV, testSimpleKV) { ASSERT_EXIT_ZERO(testSimpleKV) }
 
+/** Sums the first column of the rows it visits. */
+class IntSumReader : public Reader
+{
+public:
+  long sum_ = 0;
+
+  bool visit(Row &row)
+  {
+    sum_ += row.get_int(0);
+    return false;
+  }
+
+  void serialize(Serializer &ser) { ser.write_size_t(sum_); }
+
+  void join(Deserializer &dser) { sum_ += dser.read_size_t(); }
+};
+
+const size_t MAP_NODES = 3;
+const size_t MAP_ROWS = 5 * MAX_CHUNK_SIZE + 77;
+long map_results[MAP_NODES];  // each node's reader after the map
+long map_expected[MAP_NODES]; // sum of the rows stored on each node
+
+/**
+ * Test Application for the distributed map. Node 0 builds a dataframe whose
+ * chunks are spread over every node, then each node maps a reader over its
+ * copy of it.
+ */
+class MapApp : public Application
+{
+public:
+  MessageCheckerThread checker_;
+
+  MapApp(size_t idx, std::shared_ptr<NetworkIfc> net)
+      : Application(idx, net, MAP_NODES), checker_(idx, kv, net) {}
+
+  void run_() override
+  {
+    kv->register_node();
+    checker_.start();
+    Key dfKey("mapped-df", 0);
+    if (this_node() == 0)
+    {
+      Schema s("I");
+      DataFrame df(s);
+      Row r(df.get_schema());
+      for (size_t i = 0; i < MAP_ROWS; i++)
+      {
+        r.set(0, Int(i));
+        df.add_row(r, kv);
+      }
+      Serializer ser;
+      df.serialize(ser);
+      kv->put(dfKey, Value(ser.data(), ser.length()));
+    }
+    Value v = kv->waitAndGet(dfKey);
+    Deserializer dser(v.data(), v.length());
+    auto df = DataFrame::deserialize(dser);
+
+    IntSumReader reader;
+    df->map(reader, kv);
+    map_results[this_node()] = reader.sum_;
+    auto col = df->cols_.at(0);
+    for (size_t i = 0; i < MAP_ROWS; i++)
+    {
+      size_t chunk = i / MAX_CHUNK_SIZE;
+      size_t home = chunk < col->keys_.size() ? col->keys_.at(chunk).home_ : 0;
+      if (home == this_node())
+      {
+        map_expected[this_node()] += i;
+      }
+    }
+  }
+};
+
+class MapThread : public Thread
+{
+public:
+  MapApp app_;
+
+  MapThread(size_t node, std::shared_ptr<NetworkPseudo> net) : app_(node, net) {}
+
+  void run() { app_.run_(); }
+};
+
+void testDistributedMap()
+{
+  auto net = std::make_shared<NetworkPseudo>(MAP_NODES);
+  std::vector<std::shared_ptr<MapThread>> threads;
+  for (size_t i = 0; i < MAP_NODES; i++)
+  {
+    threads.push_back(std::make_shared<MapThread>(i, net));
+    threads.back()->start();
+  }
+  for (auto &t : threads)
+  {
+    t->join();
+  }
+  // every node scanned rows, and node 0 ended up with the total
+  for (size_t i = 1; i < MAP_NODES; i++)
+  {
+    assert(map_expected[i] > 0);
+    assert(map_results[i] == map_expected[i]);
+  }
+  long total = (long)MAP_ROWS * (MAP_ROWS - 1) / 2;
+  assert(map_expected[0] + map_expected[1] + map_expected[2] == total);
+  assert(map_results[0] == total);
+  exit(0);
+}
+
+TEST(distributedMap, testDistributedMap) { ASSERT_EXIT_ZERO(testDistributedMap) }
+
+// Tests that the node's chunk cache serves alternating chunk accesses and
+// stays within its byte budget.
+TEST(chunkCache, testChunkCache)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  for (size_t i = 0; i < 3 * MAX_CHUNK_SIZE; i++)
+  {
+    ic.push_back(i, store);
+  }
+
+  // Alternating between two stored chunks only fetches each one once
+  for (size_t i = 0; i < 10; i++)
+  {
+    ASSERT_EQ(ic.get(i, store), i);
+    ASSERT_EQ(ic.get(MAX_CHUNK_SIZE + i, store), MAX_CHUNK_SIZE + i);
+  }
+  ChunkCache &cache = store->chunk_cache_;
+  ASSERT_EQ(cache.misses(), 2);
+  ASSERT_EQ(cache.hits(), 18);
+  ASSERT_EQ(cache.size(), 2);
+
+  // With room for a single chunk, the same pattern evicts on every switch
+  cache.set_budget(cache.bytes() / 2);
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_EQ(ic.get(0, store), 0);
+  ASSERT_EQ(ic.get(MAX_CHUNK_SIZE, store), MAX_CHUNK_SIZE);
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_EQ(cache.evictions(), 3);
+}
+
+// Tests that the flush pipeline bounds the jobs in flight and rethrows their
+// errors, and that columns read back what they stored in the background.
+TEST(flushPipeline, testFlushPipeline)
+{
+  FlushPipeline pipeline(2);
+  std::atomic<size_t> running(0), most(0), done(0);
+  for (size_t i = 0; i < 20; i++)
+  {
+    pipeline.submit([&]() {
+      most = std::max(most.load(), ++running);
+      Thread::sleep(1);
+      running--;
+      done++;
+    });
+    ASSERT_LE(pipeline.in_flight_, 2);
+  }
+  pipeline.drain();
+  ASSERT_EQ(done, 20);
+  ASSERT_EQ(most, 1);
+  ASSERT_EQ(pipeline.completed_, 20);
+
+  pipeline.submit([]() { throw std::runtime_error("send failed!"); });
+  ASSERT_THROW(pipeline.drain(), std::runtime_error);
+  pipeline.drain();
+
+  // a column keeps appending while its chunks are stored, and reads wait
+  // for any that have not landed yet
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  ASSERT_TRUE(store->flusher_.async());
+  IntColumn ic;
+  for (size_t i = 0; i < 5 * MAX_CHUNK_SIZE + 7; i++)
+  {
+    ic.push_back(i, store);
+  }
+  ASSERT_EQ(ic.keys_.size(), 5);
+  for (size_t i = 0; i < ic.size(); i += 997)
+  {
+    ASSERT_EQ(ic.get(i, store), i);
+  }
+  store->flusher_.drain();
+  ASSERT_EQ(store->store_.size(), 5);
+
+  // synchronously, every chunk is in the store as soon as it is cut
+  store->flusher_.set_max_in_flight(0);
+  IntColumn sync;
+  for (size_t i = 0; i < 2 * MAX_CHUNK_SIZE + 1; i++)
+  {
+    sync.push_back(i, store);
+  }
+  ASSERT_EQ(store->store_.size(), 7);
+  ASSERT_TRUE(store->pending_.empty());
+
+  // a chunk that is neither stored nor pending is an error, not a hang,
+  // while named keys are waited for however long another node takes
+  store->max_local_wait_ms_ = 5;
+  ASSERT_THROW(store->waitAndGet(Key(ChunkId(0, 999), 0)), std::runtime_error);
+  std::thread late([&]() {
+    Thread::sleep(20);
+    store->put(Key("late", 0), Value((char *)"x", 1));
+  });
+  ASSERT_EQ(store->waitAndGet(Key("late", 0)).length(), 1);
+  late.join();
+
+  // jobs keep the store alive after its last other owner lets go of it
+  auto orphan = std::make_shared<KVStore>(0, nullptr, 1);
+  std::weak_ptr<KVStore> watch(orphan);
+  IntColumn orphaned;
+  for (size_t i = 0; i < 3 * MAX_CHUNK_SIZE + 1; i++)
+  {
+    orphaned.push_back(i, orphan);
+  }
+  orphan = nullptr;
+  while (!watch.expired())
+  {
+    Thread::sleep(1);
+  }
+}
+
+// Tests that the prefetcher fetches each key once, that readers wait on a
+// running fetch and take back a queued one, and that local chunks are read
+// without prefetching.
+TEST(prefetcher, testPrefetcher)
+{
+  Prefetcher prefetcher;
+  std::atomic<bool> release(false);
+  std::atomic<size_t> started(0), done(0);
+  auto slow = [&]() {
+    started++;
+    while (!release)
+    {
+      Thread::sleep(1);
+    }
+    done++;
+  };
+  Key k1(ChunkId(1, 1), 1), k2(ChunkId(1, 2), 1), k3(ChunkId(1, 3), 1);
+  ASSERT_TRUE(prefetcher.fetch(k1, slow));
+  ASSERT_FALSE(prefetcher.fetch(k1, slow));
+  ASSERT_TRUE(prefetcher.fetch(k2, slow));
+  while (started < Prefetcher::NUM_WORKERS)
+  {
+    Thread::sleep(1);
+  }
+  // both workers are busy, so k3 waits in the queue and is taken back
+  ASSERT_TRUE(prefetcher.fetch(k3, slow));
+  ASSERT_FALSE(prefetcher.wait(k3));
+  ASSERT_FALSE(prefetcher.wait(Key("other", 0)));
+
+  std::thread releaser([&]() {
+    Thread::sleep(10);
+    release = true;
+  });
+  ASSERT_TRUE(prefetcher.wait(k1));
+  ASSERT_GE(done, 1);
+  releaser.join();
+  ASSERT_EQ(prefetcher.issued_, 3);
+  ASSERT_EQ(prefetcher.waited_, 1);
+
+  // a reply that does not come in time is given up on, and dropped later
+  auto quiet = std::make_shared<KVStore>(0, nullptr, 1);
+  ASSERT_EQ(quiet->wait_and_pop(42, 5), nullptr);
+  Value late((char *)"x", 1);
+  Reply reply(MsgKind::Reply, 1, 0, 42, late);
+  quiet->handle_reply(reply);
+  ASSERT_TRUE(quiet->replies_.empty());
+  ASSERT_TRUE(quiet->abandoned_.empty());
+
+  // a job retrying a chunk that never arrives gives up when destroyed
+  {
+    Prefetcher stuck;
+    std::atomic<bool> running(false);
+    stuck.fetch(k1, [&]() {
+      running = true;
+      while (!stuck.stopping())
+      {
+        Thread::sleep(1);
+      }
+    });
+    while (!running)
+    {
+      Thread::sleep(1);
+    }
+  }
+
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  for (size_t i = 0; i < 4 * MAX_CHUNK_SIZE; i++)
+  {
+    ic.push_back(i, store);
+  }
+  ASSERT_EQ(ic.sum(store), (long)(4 * MAX_CHUNK_SIZE) * (4 * MAX_CHUNK_SIZE - 1) / 2);
+  ASSERT_EQ(store->prefetcher_.issued_, 0);
+}
+
 // Runs all of the tests.
 int main(int argc, char **argv)
 {
@@ -46,6 +46,41 @@ TEST(serial, test_string)
   ASSERT_TRUE(s3 == d3);
 }
 
+// Tests that named and chunk keys round-trip, and that chunk keys are compact
+TEST(serial, test_key)
+{
+  Key named("users-0-0", 1);
+  Key chunk(ChunkId(3, 42), 2);
+  EXPECT_FALSE(named.is_chunk());
+  EXPECT_TRUE(chunk.is_chunk());
+  EXPECT_EQ(chunk.id_.node(), 3);
+  EXPECT_EQ(chunk.id_.counter(), 42);
+  EXPECT_EQ(chunk.to_string(), "chunk-3-42");
+  EXPECT_EQ(ChunkId(65535, (1ULL << 48) - 1).node(), 65535);
+  EXPECT_THROW(ChunkId(65536, 1), std::runtime_error);
+  EXPECT_THROW(ChunkId(1, 1ULL << 48), std::runtime_error);
+
+  Serializer ser;
+  named.serialize(ser);
+  size_t named_len = ser.length();
+  chunk.serialize(ser);
+  EXPECT_EQ(ser.length() - named_len, 2 * sizeof(size_t));
+  Deserializer dser(ser.data(), ser.length());
+  auto d_named = Key::deserialize(dser);
+  auto d_chunk = Key::deserialize(dser);
+  EXPECT_EQ(d_named->name_, "users-0-0");
+  EXPECT_EQ(d_named->home_, 1);
+  EXPECT_FALSE(d_named->is_chunk());
+  EXPECT_EQ(d_chunk->id_, chunk.id_);
+  EXPECT_EQ(d_chunk->home_, 2);
+
+  KeyCompare less;
+  EXPECT_TRUE(less(named, chunk));
+  EXPECT_TRUE(less(Key(ChunkId(0, 1), 0), Key(ChunkId(1, 1), 0)));
+  EXPECT_FALSE(less(Key(ChunkId(1, 1), 0), Key(ChunkId(1, 1), 5)));
+  EXPECT_TRUE(less(Key("a", 0), Key("b", 0)));
+}
+
 // Tests that vectors of strings can be serialized and deserialized properly.
 TEST(serial, test_string_vector)
 {
@@ -183,6 +218,289 @@ TEST(serial, test_string_column)
   }
 }
 
+// Tests that a column's validity bitmap survives serialization.
+TEST(serial, test_column_missing)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  IntColumn ic;
+  for (int i = 0; i < 100; i++)
+  {
+    ic.push_back(i, store);
+    if (i % 3 == 0)
+    {
+      ic.mark_missing(i);
+    }
+  }
+
+  Serializer ser;
+  ic.serialize(ser);
+
+  Deserializer dser(ser.data(), ser.length());
+  auto ic2 = IntColumn::deserialize(dser);
+
+  ASSERT_EQ(ic2->null_count(store), 34);
+  for (size_t i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(ic2->is_missing(i, store), i % 3 == 0);
+  }
+}
+
+// Tests that a column's zone maps travel with its keys.
+TEST(serial, test_zone_maps)
+{
+  auto store = std::make_shared<KVStore>(0, nullptr, 1);
+  DoubleColumn dc;
+  for (size_t i = 0; i < 2 * MAX_CHUNK_SIZE + 3; i++)
+  {
+    dc.push_back(i % 100 - 50.5, store);
+    if (i % 7 == 0)
+    {
+      dc.mark_missing(i);
+    }
+  }
+
+  Serializer ser;
+  dc.serialize(ser);
+
+  Deserializer dser(ser.data(), ser.length());
+  auto dc2 = DoubleColumn::deserialize(dser);
+
+  ASSERT_EQ(dc2->stats_.size(), 2);
+  for (size_t i = 0; i < 2; i++)
+  {
+    EXPECT_EQ(dc2->stats_[i].min_, -50.5);
+    EXPECT_EQ(dc2->stats_[i].max_, 48.5);
+    EXPECT_EQ(dc2->stats_[i].null_count_, dc.stats_[i].null_count_);
+  }
+  EXPECT_EQ(dc2->distinct_estimate(), dc.distinct_estimate());
+  EXPECT_FALSE(dc2->chunk_may_match(0, 49, 60));
+  EXPECT_TRUE(dc2->chunk_may_match(1, 48, 60));
+}
+
+// Spreads i over the whole int range, so that no codec can compress it
+int scramble(size_t i) { return (int)(i * 2654435761u); }
+
+// Tests that chunk views read values in place from the stored bytes.
+TEST(serial, test_chunk_view)
+{
+  IntColumnChunk ic;
+  DoubleColumnChunk dc;
+  for (int i = 0; i < 1000; i++)
+  {
+    ic.push_back(scramble(i)); // incompressible, so stored plain
+    dc.push_back(i * 0.5);
+  }
+  dc.mark_missing(10);
+
+  Serializer iser;
+  ic.serialize(iser);
+  Value iv(iser.data(), iser.length());
+  ColumnChunkView iview(iv);
+  ASSERT_EQ(iview.get_type(), 'I');
+  ASSERT_EQ(iview.size(), 1000);
+  ASSERT_EQ(iview.null_count(), 0);
+  // The view reads from the value's buffer rather than a copy of it
+  ASSERT_TRUE((const char *)iview.ints() > iv.data());
+  ASSERT_TRUE((const char *)iview.ints() < iv.data() + iv.length());
+  ASSERT_EQ((size_t)iview.ints() % alignof(int), 0);
+
+  Serializer dser;
+  dc.serialize(dser);
+  ColumnChunkView dview(Value(dser.data(), dser.length()));
+  ASSERT_EQ((size_t)dview.doubles() % alignof(double), 0);
+  ASSERT_EQ(dview.null_count(), 1);
+  ASSERT_TRUE(dview.is_missing(10));
+  for (size_t i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(iview.get_int(i), scramble(i));
+    ASSERT_EQ(dview.get_double(i), i * 0.5);
+  }
+
+  // The write path chunk can still be rebuilt from the same bytes
+  Deserializer d(iser.data(), iser.length());
+  auto ic2 = IntColumnChunk::deserialize(d);
+  ASSERT_EQ(ic2->vals_, ic.vals_);
+}
+
+// Tests that low-cardinality string chunks are dictionary encoded, and that
+// both encodings read back the same values.
+TEST(serial, test_dict_chunk)
+{
+  std::vector<std::string> names = {"linux", "git", "emacs"};
+  StringColumnChunk low;
+  StringColumnChunk high;
+  for (size_t i = 0; i < 1000; i++)
+  {
+    low.push_back(names[i % 3]);
+    high.push_back(std::to_string(i));
+  }
+  low.mark_missing(4);
+
+  Serializer lser;
+  low.serialize(lser);
+  ColumnChunkView lview(Value(lser.data(), lser.length()));
+  ASSERT_TRUE(lview.is_dict());
+  ASSERT_EQ(lview.dict_size(), 3);
+  ASSERT_EQ((size_t)lview.codes_ % alignof(uint32_t), 0);
+  ASSERT_LT(lser.length(), 1000 * sizeof(uint32_t) + 300);
+  ASSERT_EQ(lview.find_code("git"), 1);
+  ASSERT_EQ(lview.find_code("vim"), -1);
+  ASSERT_TRUE(lview.is_missing(4));
+
+  Serializer hser;
+  high.serialize(hser);
+  ColumnChunkView hview(Value(hser.data(), hser.length()));
+  ASSERT_FALSE(hview.is_dict());
+  for (size_t i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(lview.get_string(i), names[i % 3]);
+    ASSERT_EQ(hview.get_string(i), std::to_string(i));
+  }
+
+  Deserializer d(lser.data(), lser.length());
+  auto low2 = StringColumnChunk::deserialize(d);
+  ASSERT_EQ(low2->vals_, low.vals_);
+  ASSERT_TRUE(low2->is_missing(4));
+}
+
+// Tests that string arenas round trip, and that views of plain string chunks
+// read strings straight out of the stored bytes.
+TEST(serial, test_string_arena)
+{
+  StringArena arena;
+  StringColumnChunk chunk;
+  for (size_t i = 0; i < 500; i++)
+  {
+    arena.push_back(std::to_string(i * 7));
+    chunk.push_back(std::to_string(i * 7));
+  }
+  arena.push_back("");
+  ASSERT_EQ(arena.size(), 501);
+  ASSERT_EQ(arena.get(3), "21");
+  ASSERT_EQ(arena.get(500), "");
+
+  Serializer ser;
+  arena.serialize(ser);
+  Deserializer dser(ser.data(), ser.length());
+  StringArena arena2 = StringArena::deserialize(dser);
+  ASSERT_TRUE(arena2 == arena);
+
+  Serializer cser;
+  chunk.serialize(cser);
+  Value v(cser.data(), cser.length());
+  ColumnChunkView view(v);
+  ASSERT_FALSE(view.is_dict());
+  for (size_t i = 0; i < 500; i++)
+  {
+    std::string_view str = view.get_string(i);
+    ASSERT_EQ(str, arena.get(i));
+    ASSERT_TRUE(str.data() > v.data() && str.data() < v.data() + v.length());
+  }
+
+  // Rows keep their own copies of string fields
+  Schema s("SS");
+  Row r(s);
+  r.set_string(0, view.get_string(10));
+  r.set(1, String("pear"));
+  Row copy(r);
+  r.set_string(0, "apple");
+  ASSERT_EQ(copy.get_string(0), "70");
+  ASSERT_EQ(copy.get_string(1), "pear");
+  ASSERT_EQ(r.get_string(0), "apple");
+}
+
+// Tests that int chunks pick a codec that fits their values, and that every
+// codec decodes back to the original values.
+TEST(serial, test_int_codecs)
+{
+  std::vector<std::vector<int>> inputs(5);
+  for (int i = 0; i < 1000; i++)
+  {
+    inputs[0].push_back(1000000 + i * 7 + i % 3); // sorted ids
+    inputs[1].push_back(500 + (i * 37) % 200);    // clustered
+    inputs[2].push_back(i / 100);                 // long runs
+    inputs[3].push_back(scramble(i));             // incompressible
+    inputs[4].push_back(42);                      // constant
+  }
+  inputs[3].push_back(INT_MIN);
+  inputs[3].push_back(INT_MAX);
+  uint8_t expected[] = {ENCODING_DELTA, ENCODING_FOR, ENCODING_RLE, ENCODING_PLAIN, ENCODING_RLE};
+  for (size_t k = 0; k < inputs.size(); k++)
+  {
+    IntColumnChunk chunk(inputs[k]);
+    Serializer ser;
+    chunk.serialize(ser);
+    Value v(ser.data(), ser.length());
+    ColumnChunkView view(v);
+    ASSERT_EQ(view.header_->encoding_, expected[k]);
+    for (size_t i = 0; i < inputs[k].size(); i++)
+    {
+      ASSERT_EQ(view.get_int(i), inputs[k][i]);
+    }
+    Deserializer dser(ser.data(), ser.length());
+    ASSERT_EQ(IntColumnChunk::deserialize(dser)->vals_, inputs[k]);
+  }
+
+  // every bit width survives packing, including the scalar tails
+  for (uint64_t width = 0; width <= 32; width++)
+  {
+    std::vector<uint64_t> vals;
+    for (size_t i = 0; i < 301; i++)
+    {
+      vals.push_back(width == 0 ? 0 : (i * 2654435761u) & ((1ULL << width) - 1));
+    }
+    std::vector<uint64_t> words = IntCodecs::pack(vals, width);
+    std::vector<uint32_t> out(vals.size());
+    IntCodecs::unpack(words.data(), vals.size(), width, 5, out.data());
+    for (size_t i = 0; i < vals.size(); i++)
+    {
+      ASSERT_EQ(out[i], (uint32_t)(vals[i] + 5));
+    }
+  }
+
+  // sorted ids move several times less data than plain ints
+  ASSERT_LT(IntCodecs::delta_size(inputs[0]) * 3, IntCodecs::plain_size(inputs[0]));
+}
+
+// Tests that slowly varying double chunks are XOR-compressed, and that the
+// codec round trips every bit pattern.
+TEST(serial, test_double_codec)
+{
+  std::vector<double> slow;
+  std::vector<double> noisy;
+  for (size_t i = 0; i < 1000; i++)
+  {
+    slow.push_back(20.0 + (i / 10) * 0.25);
+    noisy.push_back(scramble(i) / 7.0);
+  }
+  slow[500] = -0.0;
+  slow[501] = NAN;
+  slow[502] = INFINITY;
+
+  DoubleColumnChunk chunk(slow);
+  Serializer ser;
+  chunk.serialize(ser);
+  ColumnChunkView view(Value(ser.data(), ser.length()));
+  ASSERT_EQ(view.header_->encoding_, ENCODING_XOR);
+  ASSERT_LT(ser.length(), 2 * slow.size());
+  Deserializer dser(ser.data(), ser.length());
+  auto chunk2 = DoubleColumnChunk::deserialize(dser);
+  for (size_t i = 0; i < slow.size(); i++)
+  {
+    ASSERT_EQ(memcmp(&view.doubles()[i], &slow[i], sizeof(double)), 0);
+    ASSERT_EQ(memcmp(&chunk2->vals_[i], &slow[i], sizeof(double)), 0);
+  }
+
+  DoubleColumnChunk noisy_chunk(noisy);
+  Serializer nser;
+  noisy_chunk.serialize(nser);
+  ColumnChunkView nview(Value(nser.data(), nser.length()));
+  ASSERT_EQ(nview.header_->encoding_, ENCODING_PLAIN);
+  std::vector<double> out(noisy.size());
+  DoubleCodecs::decode_xor(DoubleCodecs::encode_xor(noisy).data(), noisy.size(), out.data());
+  ASSERT_EQ(out, noisy);
+}
+
 // Tests that schemas can be serialized and deserialized properly.
 TEST(serial, test_schema)
 {